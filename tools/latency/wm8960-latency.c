@@ -0,0 +1,456 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Round-trip latency benchmark: plays an impulse, captures it back and
+ * reports the latency distribution for each rate and period size.
+ *
+ * On the WM8960 the output has to be cabled back to an input. The codec
+ * has no path for this of its own: the "Digital Loopback Switch" feeds
+ * the ADC into the DAC in place of what is played over I2S, and there is
+ * no analogue path from the DAC back to the ADC. Without the hardware,
+ * -L runs against the snd-aloop card, where what is played on
+ * hw:Loopback,0 is captured on hw:Loopback,1.
+ *
+ * Two figures are given per impulse. The path latency is the distance
+ * in frames between the impulse in the playback and capture streams,
+ * which both start on the same trigger, so it is what the codec and the
+ * links add. The round trip is the time from writing the impulse to
+ * reading it back, which adds the buffering and scheduling of the stack.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <alsa/asoundlib.h>
+
+#define DEFAULT_RATES	"8000,16000,44100,48000"
+#define DEFAULT_PERIODS	"64,128,256,512"
+#define MAX_LIST	16
+#define CHANNELS	2
+#define PERIODS		2
+#define IMPULSE		16384
+
+struct config {
+	const char *playback;
+	const char *capture;
+	unsigned int rates[MAX_LIST];
+	int num_rates;
+	snd_pcm_uframes_t periods[MAX_LIST];
+	int num_periods;
+	int iterations;
+	int threshold;
+	int verbose;
+};
+
+struct run {
+	snd_pcm_t *play;
+	snd_pcm_t *cap;
+	unsigned int rate;
+	snd_pcm_uframes_t period;
+	snd_pcm_uframes_t buffer;
+	short *buf;
+};
+
+/* What one impulse gave, path < 0 when it never came back */
+struct result {
+	long path;
+	double round_trip_ms;
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int parse_list(const char *s, unsigned long *out)
+{
+	char *end;
+	int n = 0;
+
+	while (*s && n < MAX_LIST) {
+		out[n] = strtoul(s, &end, 0);
+		if (end == s || !out[n] || (*end && *end != ','))
+			return -EINVAL;
+		n++;
+		s = *end ? end + 1 : end;
+	}
+
+	return n;
+}
+
+static int set_params(snd_pcm_t *pcm, struct run *r)
+{
+	snd_pcm_uframes_t period = r->period, buffer = r->period * PERIODS;
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_uframes_t boundary;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_sw_params_alloca(&sw);
+
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_rate_resample(pcm, hw, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_access(pcm, hw,
+					   SND_PCM_ACCESS_RW_INTERLEAVED);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_channels(pcm, hw, CHANNELS);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_rate(pcm, hw, r->rate, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_period_size(pcm, hw, period, 0);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params_set_buffer_size(pcm, hw, buffer);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_params(pcm, hw);
+	if (err < 0)
+		return err;
+
+	/* Neither stream starts on its own, the playback start does both */
+	err = snd_pcm_sw_params_current(pcm, sw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_get_boundary(sw, &boundary);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_set_start_threshold(pcm, sw, boundary);
+	if (err < 0)
+		return err;
+	err = snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+	if (err < 0)
+		return err;
+
+	return snd_pcm_sw_params(pcm, sw);
+}
+
+static int open_run(const struct config *cfg, struct run *r,
+		    unsigned int rate, snd_pcm_uframes_t period)
+{
+	int err;
+
+	memset(r, 0, sizeof(*r));
+	r->rate = rate;
+	r->period = period;
+	r->buffer = period * PERIODS;
+
+	err = snd_pcm_open(&r->play, cfg->playback, SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0) {
+		fprintf(stderr, "%s: %s\n", cfg->playback, snd_strerror(err));
+		return err;
+	}
+
+	err = snd_pcm_open(&r->cap, cfg->capture, SND_PCM_STREAM_CAPTURE, 0);
+	if (err < 0) {
+		fprintf(stderr, "%s: %s\n", cfg->capture, snd_strerror(err));
+		return err;
+	}
+
+	err = set_params(r->play, r);
+	if (!err)
+		err = set_params(r->cap, r);
+	if (err < 0) {
+		if (cfg->verbose)
+			fprintf(stderr, "%u Hz, %lu frames: %s\n", rate,
+				period, snd_strerror(err));
+		return err;
+	}
+
+	err = snd_pcm_link(r->play, r->cap);
+	if (err < 0) {
+		fprintf(stderr, "Cannot link %s and %s: %s\n", cfg->playback,
+			cfg->capture, snd_strerror(err));
+		return err;
+	}
+
+	r->buf = calloc(r->period * CHANNELS, sizeof(*r->buf));
+	if (!r->buf)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void close_run(struct run *r)
+{
+	if (r->play && r->cap)
+		snd_pcm_unlink(r->play);
+	if (r->cap)
+		snd_pcm_close(r->cap);
+	if (r->play)
+		snd_pcm_close(r->play);
+	free(r->buf);
+}
+
+static int write_period(struct run *r, long pos, long impulse_at)
+{
+	snd_pcm_sframes_t n;
+	int c;
+
+	memset(r->buf, 0, r->period * CHANNELS * sizeof(*r->buf));
+	if (impulse_at >= pos && impulse_at < pos + (long)r->period)
+		for (c = 0; c < CHANNELS; c++)
+			r->buf[(impulse_at - pos) * CHANNELS + c] = IMPULSE;
+
+	n = snd_pcm_writei(r->play, r->buf, r->period);
+
+	return n < 0 ? n : 0;
+}
+
+/* Send one impulse round, returns -EPIPE on an xrun */
+static int measure(const struct config *cfg, struct run *r,
+		   struct result *res)
+{
+	/* Let the streams settle for 100 ms before the impulse */
+	long impulse_at = r->buffer + r->rate / 10;
+	/* and give up on it after a second */
+	long end = impulse_at + r->rate;
+	long written = 0, captured = 0;
+	double sent = 0;
+	snd_pcm_sframes_t n;
+	long i;
+	int err;
+
+	res->path = -1;
+
+	/* Prepares and later starts and stops both linked streams */
+	err = snd_pcm_prepare(r->play);
+	if (err < 0)
+		return err;
+
+	while (written < (long)r->buffer) {
+		err = write_period(r, written, impulse_at);
+		if (err < 0)
+			goto out;
+		written += r->period;
+	}
+
+	err = snd_pcm_start(r->play);
+	if (err < 0)
+		goto out;
+
+	while (captured < end && res->path < 0) {
+		n = snd_pcm_readi(r->cap, r->buf, r->period);
+		if (n < 0) {
+			err = n;
+			goto out;
+		}
+
+		for (i = 0; i < n * CHANNELS; i++) {
+			if (abs(r->buf[i]) >= cfg->threshold) {
+				res->path = captured + i / CHANNELS - impulse_at;
+				res->round_trip_ms = now_ms() - sent;
+				break;
+			}
+		}
+		captured += n;
+
+		if (impulse_at >= written &&
+		    impulse_at < written + (long)r->period)
+			sent = now_ms();
+		err = write_period(r, written, impulse_at);
+		if (err < 0)
+			goto out;
+		written += r->period;
+	}
+
+out:
+	snd_pcm_drop(r->play);
+
+	return err;
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Returns the number of impulses that did not come back. Those lost to
+ * an xrun are only counted, as a loaded machine may miss a short period.
+ */
+static int bench(const struct config *cfg, unsigned int rate,
+		 snd_pcm_uframes_t period)
+{
+	long *path = calloc(cfg->iterations, sizeof(*path));
+	double *rt = calloc(cfg->iterations, sizeof(*rt));
+	int i, n = 0, xruns = 0, lost = 0;
+	struct result res;
+	struct run r;
+	int err;
+
+	if (!path || !rt) {
+		free(path);
+		free(rt);
+		return cfg->iterations;
+	}
+
+	err = open_run(cfg, &r, rate, period);
+	if (err < 0) {
+		close_run(&r);
+		free(path);
+		free(rt);
+		printf("%6u %6lu %6s   not supported\n", rate, period, "-");
+		/* an unsupported setup is skipped, failing to open is not */
+		return err == -EINVAL ? 0 : cfg->iterations;
+	}
+
+	for (i = 0; i < cfg->iterations; i++) {
+		err = measure(cfg, &r, &res);
+		if (err == -EPIPE || err == -ESTRPIPE) {
+			xruns++;
+			continue;
+		} else if (err < 0) {
+			fprintf(stderr, "%u Hz, %lu frames: %s\n", rate, period,
+				snd_strerror(err));
+			lost += cfg->iterations - i;
+			break;
+		}
+
+		if (res.path < 0) {
+			lost++;
+			continue;
+		}
+
+		path[n] = res.path;
+		rt[n] = res.round_trip_ms;
+		n++;
+	}
+
+	if (n) {
+		qsort(path, n, sizeof(*path), cmp_long);
+		qsort(rt, n, sizeof(*rt), cmp_double);
+		printf("%6u %6lu %6lu   %5ld %5ld %5ld   %7.2f %7.2f %7.2f %7.2f   %3d %3d\n",
+		       rate, r.period, r.buffer,
+		       path[0], path[n / 2], path[n - 1],
+		       rt[0], rt[n / 2], rt[(n * 95) / 100], rt[n - 1],
+		       xruns, lost);
+	} else {
+		printf("%6u %6lu %6lu   no impulse came back (%d xruns)\n",
+		       rate, r.period, r.buffer, xruns);
+	}
+
+	close_run(&r);
+	free(path);
+	free(rt);
+
+	return lost;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -P DEV    playback device (default hw:wm8960)\n"
+		"  -C DEV    capture device (default hw:wm8960)\n"
+		"  -L        use the snd-aloop card instead of the codec\n"
+		"  -r LIST   rates in Hz (default " DEFAULT_RATES ")\n"
+		"  -p LIST   period sizes in frames (default " DEFAULT_PERIODS ")\n"
+		"  -n N      impulses per rate and period size (default 20)\n"
+		"  -t LEVEL  detection threshold, 1 to 32767 (default 4096)\n"
+		"  -v        report setups that cannot be opened\n"
+		"\n"
+		"Path latency is in frames, round trip times in ms as min,\n"
+		"median, 95th percentile and max, followed by the impulses\n"
+		"lost to xruns and those that never came back. Exits non-zero\n"
+		"when any never came back.\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct config cfg = {
+		.playback = "hw:wm8960",
+		.capture = "hw:wm8960",
+		.iterations = 20,
+		.threshold = 4096,
+	};
+	const char *rates = DEFAULT_RATES, *periods = DEFAULT_PERIODS;
+	unsigned long list[MAX_LIST];
+	int i, j, opt, lost = 0;
+
+	while ((opt = getopt(argc, argv, "P:C:Lr:p:n:t:vh")) != -1) {
+		switch (opt) {
+		case 'P':
+			cfg.playback = optarg;
+			break;
+		case 'C':
+			cfg.capture = optarg;
+			break;
+		case 'L':
+			cfg.playback = "hw:Loopback,0";
+			cfg.capture = "hw:Loopback,1";
+			break;
+		case 'r':
+			rates = optarg;
+			break;
+		case 'p':
+			periods = optarg;
+			break;
+		case 'n':
+			cfg.iterations = atoi(optarg);
+			break;
+		case 't':
+			cfg.threshold = atoi(optarg);
+			break;
+		case 'v':
+			cfg.verbose = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+
+	cfg.num_rates = parse_list(rates, list);
+	for (i = 0; i < cfg.num_rates; i++)
+		cfg.rates[i] = list[i];
+	cfg.num_periods = parse_list(periods, list);
+	for (i = 0; i < cfg.num_periods; i++)
+		cfg.periods[i] = list[i];
+
+	if (cfg.num_rates <= 0 || cfg.num_periods <= 0 ||
+	    cfg.iterations <= 0 || cfg.threshold <= 0 ||
+	    cfg.threshold > 32767) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	printf("%s -> %s, %d impulses each\n", cfg.playback, cfg.capture,
+	       cfg.iterations);
+	printf("%6s %6s %6s   %17s   %31s\n", "rate", "period", "buffer",
+	       "path (frames)", "round trip (ms)");
+	printf("%6s %6s %6s   %5s %5s %5s   %7s %7s %7s %7s   %3s %3s\n",
+	       "", "", "", "min", "med", "max", "min", "med", "p95", "max",
+	       "xr", "lost");
+
+	for (i = 0; i < cfg.num_rates; i++)
+		for (j = 0; j < cfg.num_periods; j++)
+			lost += bench(&cfg, cfg.rates[i], cfg.periods[j]);
+
+	return lost ? 1 : 0;
+}
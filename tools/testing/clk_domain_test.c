@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Clock domain stress test: codecs in one wlf,clock-domain start and stop
+ * streams at random rates from concurrent threads, while one more member
+ * keeps binding and unbinding. Whenever several members are clocked they
+ * must run with the same dividers, and only one may be master at a time.
+ * A codec on the same MCLK outside the domain is never held back, and
+ * neither are members by one that is only kept warm between streams.
+ */
+
+#include "../../wm8960.c"
+#include "test.h"
+
+#define NR_MEMBERS	4
+#define ITERATIONS	2000
+
+static const unsigned int test_rates[] = {
+	8000, 16000, 32000, 44100, 48000,
+};
+
+static const u32 domain_id = 1;
+static const struct property member_props[] = {
+	{ "wlf,clock-domain", &domain_id, 1 },
+	{ }
+};
+
+static struct clk mclk = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.rate = 12288000,
+};
+
+/* What the clocked members were seen running with */
+struct clk_state {
+	unsigned int clock1;
+	unsigned int clock2;
+	unsigned int pll;
+	unsigned int pll_regs[4];
+};
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct clk_state state;
+static int clocked;
+static int masters;
+static int conflicts;
+static int overlaps;
+static volatile bool churning = true;
+
+static struct clk_state test_clk_state(struct test_codec *tc)
+{
+	struct clk_state s = { };
+	int i;
+
+	pthread_mutex_lock(&tc->adap.lock);
+	s.clock1 = tc->adap.regs[WM8960_CLOCK1] & 0x1ff;
+	s.clock2 = tc->adap.regs[WM8960_CLOCK2] & 0xf;
+	s.pll = tc->adap.regs[WM8960_POWER2] & 0x1;
+	for (i = 0; s.pll && i < 4; i++)
+		s.pll_regs[i] = tc->adap.regs[WM8960_PLL1 + i];
+	pthread_mutex_unlock(&tc->adap.lock);
+
+	return s;
+}
+
+static void test_stream(struct test_codec *tc, unsigned int *seed,
+			bool member)
+{
+	const struct snd_soc_dai_ops *ops = tc->dai->driver->ops;
+	struct snd_pcm_substream substream = {
+		.stream = rand_r(seed) % 2,
+	};
+	struct snd_pcm_hw_params params;
+	bool master = member && rand_r(seed) % 4 == 0;
+	struct clk_state s;
+	int ret;
+
+	if (master) {
+		ret = ops->set_fmt(tc->dai, SND_SOC_DAIFMT_I2S |
+				   SND_SOC_DAIFMT_NB_NF |
+				   SND_SOC_DAIFMT_CBM_CFM);
+		if (ret) {
+			CHECK(ret == -EBUSY, "set_fmt: %d", ret);
+			master = false;
+		} else {
+			pthread_mutex_lock(&state_lock);
+			CHECK(++masters == 1, "%d masters", masters);
+			pthread_mutex_unlock(&state_lock);
+		}
+	}
+
+	test_params(&params, SNDRV_PCM_FORMAT_S16_LE,
+		    test_rates[rand_r(seed) % ARRAY_SIZE(test_rates)], 2);
+	ret = ops->hw_params(&substream, &params, tc->dai);
+	CHECK(!ret, "%s: hw_params: %d", tc->i2c.dev.name, ret);
+
+	ret = shim_set_bias_level(tc->component, SND_SOC_BIAS_ON);
+	if (ret) {
+		/* Only a clocked member running another rate holds us back */
+		CHECK(member && ret == -EBUSY, "%s: bias ON: %d",
+		      tc->i2c.dev.name, ret);
+		pthread_mutex_lock(&state_lock);
+		conflicts++;
+		pthread_mutex_unlock(&state_lock);
+	} else if (member) {
+		s = test_clk_state(tc);
+
+		pthread_mutex_lock(&state_lock);
+		if (clocked++) {
+			overlaps++;
+			CHECK(!memcmp(&s, &state, sizeof(s)),
+			      "%s runs CLOCK1 %#x CLOCK2 %#x alongside CLOCK1 %#x CLOCK2 %#x",
+			      tc->i2c.dev.name, s.clock1, s.clock2,
+			      state.clock1, state.clock2);
+		} else {
+			state = s;
+		}
+		pthread_mutex_unlock(&state_lock);
+
+		usleep(rand_r(seed) % 50);
+
+		pthread_mutex_lock(&state_lock);
+		clocked--;
+		pthread_mutex_unlock(&state_lock);
+	}
+
+	ret = shim_set_bias_level(tc->component, SND_SOC_BIAS_STANDBY);
+	CHECK(!ret, "%s: bias STANDBY: %d", tc->i2c.dev.name, ret);
+	ops->hw_free(&substream, tc->dai);
+
+	if (master) {
+		pthread_mutex_lock(&state_lock);
+		masters--;
+		pthread_mutex_unlock(&state_lock);
+		ops->set_fmt(tc->dai, SND_SOC_DAIFMT_I2S |
+			     SND_SOC_DAIFMT_NB_NF | SND_SOC_DAIFMT_CBS_CFS);
+	}
+}
+
+static void *test_member(void *data)
+{
+	struct test_codec *tc = data;
+	unsigned int seed = (uintptr_t)data;
+	int i;
+
+	for (i = 0; i < ITERATIONS; i++)
+		test_stream(tc, &seed, true);
+
+	return NULL;
+}
+
+/* Join and leave the domain while the others run */
+static void *test_churn(void *data)
+{
+	unsigned int seed = 1;
+	struct test_codec tc;
+	int ret;
+
+	while (churning) {
+		ret = test_codec_probe(&tc, "churn", &mclk, member_props);
+		CHECK(!ret, "churn probe: %d", ret);
+		if (ret)
+			break;
+		tc.dai->driver->ops->set_sysclk(tc.dai, WM8960_SYSCLK_AUTO,
+						mclk.rate, 0);
+		if (rand_r(&seed) % 2)
+			test_stream(&tc, &seed, true);
+		test_codec_remove(&tc);
+	}
+
+	return NULL;
+}
+
+/* A codec on the same crystal but another link runs what it likes */
+static void *test_outsider(void *data)
+{
+	struct test_codec *tc = data;
+	unsigned int seed = 2;
+	int i;
+
+	for (i = 0; i < ITERATIONS; i++)
+		test_stream(tc, &seed, false);
+
+	return NULL;
+}
+
+static void test_domain_mclk_mismatch(void)
+{
+	struct clk other = { .lock = PTHREAD_MUTEX_INITIALIZER, .rate = 12e6 };
+	struct test_codec a, b;
+	int ret;
+
+	ret = test_codec_probe(&a, "a", &mclk, member_props);
+	CHECK(!ret, "probe: %d", ret);
+
+	ret = test_codec_probe(&b, "b", &other, member_props);
+	CHECK(ret == -EINVAL, "member on another MCLK probed: %d", ret);
+
+	/* The domain outlives its first member */
+	ret = test_codec_probe(&b, "b", &mclk, member_props);
+	CHECK(!ret, "probe: %d", ret);
+	test_codec_remove(&a);
+	ret = test_codec_probe(&a, "a", &mclk, member_props);
+	CHECK(!ret, "probe: %d", ret);
+
+	test_codec_remove(&a);
+	test_codec_remove(&b);
+	CHECK(list_empty(&wm8960_clk_domains), "domain left behind");
+}
+
+/* An adjustable MCLK keeps its rate while other members rely on it */
+static void test_domain_mclk_rate(void)
+{
+	static const unsigned long rates[] = { 12288000, 11289600 };
+	static const u32 mclk_rates[] = { 12288000, 11289600 };
+	static const struct property props[] = {
+		{ "wlf,clock-domain", &domain_id, 1 },
+		{ "wlf,mclk-rates", mclk_rates, ARRAY_SIZE(mclk_rates) },
+		{ }
+	};
+	struct clk adjustable = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.rate = 12288000,
+		.rates = rates,
+		.num_rates = ARRAY_SIZE(rates),
+	};
+	struct snd_pcm_substream substream = {
+		.stream = SNDRV_PCM_STREAM_PLAYBACK,
+	};
+	struct snd_pcm_hw_params params;
+	struct test_codec a, b;
+	int ret;
+
+	ret = test_codec_probe(&a, "a", &adjustable, props);
+	CHECK(!ret, "probe: %d", ret);
+	ret = test_codec_probe(&b, "b", &adjustable, props);
+	CHECK(!ret, "probe: %d", ret);
+	if (ret)
+		return;
+	a.dai->driver->ops->set_sysclk(a.dai, WM8960_SYSCLK_AUTO,
+				       adjustable.rate, 0);
+	b.dai->driver->ops->set_sysclk(b.dai, WM8960_SYSCLK_AUTO,
+				       adjustable.rate, 0);
+
+	test_params(&params, SNDRV_PCM_FORMAT_S16_LE, 44100, 2);
+	ret = a.dai->driver->ops->hw_params(&substream, &params, a.dai);
+	CHECK(!ret, "hw_params: %d", ret);
+	CHECK(adjustable.rate == 12288000,
+	      "MCLK moved to %lu Hz under an idle member", adjustable.rate);
+	a.dai->driver->ops->hw_free(&substream, a.dai);
+
+	test_codec_remove(&b);
+
+	ret = a.dai->driver->ops->hw_params(&substream, &params, a.dai);
+	CHECK(!ret, "hw_params: %d", ret);
+	CHECK(adjustable.rate == 11289600,
+	      "MCLK left at %lu Hz for a lone member", adjustable.rate);
+	a.dai->driver->ops->hw_free(&substream, a.dai);
+
+	test_codec_remove(&a);
+}
+
+/* A codec kept warm after its stream does not hold the domain */
+static void test_domain_keep_warm(void)
+{
+	struct snd_pcm_substream substream = {
+		.stream = SNDRV_PCM_STREAM_PLAYBACK,
+	};
+	struct snd_pcm_hw_params params;
+	struct test_codec a, b;
+	int ret;
+
+	ret = test_codec_probe(&a, "a", &mclk, member_props);
+	CHECK(!ret, "probe: %d", ret);
+	ret = test_codec_probe(&b, "b", &mclk, member_props);
+	CHECK(!ret, "probe: %d", ret);
+	if (ret)
+		return;
+	a.dai->driver->ops->set_sysclk(a.dai, WM8960_SYSCLK_AUTO, mclk.rate, 0);
+	b.dai->driver->ops->set_sysclk(b.dai, WM8960_SYSCLK_AUTO, mclk.rate, 0);
+	test_put_control(&a, "Keep Warm Time", 1000);
+	shim_defer_work = true;
+
+	test_params(&params, SNDRV_PCM_FORMAT_S16_LE, 48000, 2);
+	a.dai->driver->ops->hw_params(&substream, &params, a.dai);
+	ret = shim_set_bias_level(a.component, SND_SOC_BIAS_ON);
+	CHECK(!ret, "a: bias ON: %d", ret);
+	shim_set_bias_level(a.component, SND_SOC_BIAS_STANDBY);
+	a.dai->driver->ops->hw_free(&substream, a.dai);
+	CHECK(a.wm8960->clk_warm && mclk.enabled == 1,
+	      "a not kept warm, MCLK enabled %d times", mclk.enabled);
+
+	/* b picks another rate while a is idle */
+	test_params(&params, SNDRV_PCM_FORMAT_S16_LE, 44100, 2);
+	b.dai->driver->ops->hw_params(&substream, &params, b.dai);
+	ret = shim_set_bias_level(b.component, SND_SOC_BIAS_ON);
+	CHECK(!ret, "b held back by a warm codec: %d", ret);
+
+	/* a cannot follow b, and gives up its warm clocks */
+	test_params(&params, SNDRV_PCM_FORMAT_S16_LE, 48000, 2);
+	a.dai->driver->ops->hw_params(&substream, &params, a.dai);
+	ret = shim_set_bias_level(a.component, SND_SOC_BIAS_ON);
+	CHECK(ret == -EBUSY, "a ran 48 kHz alongside 44.1 kHz: %d", ret);
+	CHECK(!a.wm8960->clk_warm && mclk.enabled == 1,
+	      "a kept its clocks, MCLK enabled %d times", mclk.enabled);
+	CHECK(a.wm8960->clk_domain->active == 1,
+	      "%u members clocked", a.wm8960->clk_domain->active);
+
+	/* and takes the domain over once b is idle too */
+	shim_set_bias_level(b.component, SND_SOC_BIAS_STANDBY);
+	b.dai->driver->ops->hw_free(&substream, b.dai);
+	CHECK(!b.wm8960->clk_domain_active, "b still clocked");
+	ret = shim_set_bias_level(a.component, SND_SOC_BIAS_ON);
+	CHECK(!ret, "a: bias ON: %d", ret);
+	shim_set_bias_level(a.component, SND_SOC_BIAS_STANDBY);
+	a.dai->driver->ops->hw_free(&substream, a.dai);
+
+	shim_flush_delayed_work(&a.wm8960->keep_warm_work);
+	shim_flush_delayed_work(&b.wm8960->keep_warm_work);
+	CHECK(!mclk.enabled, "MCLK left enabled %d times", mclk.enabled);
+	shim_defer_work = false;
+
+	test_codec_remove(&a);
+	test_codec_remove(&b);
+}
+
+static void test_domain_stress(void)
+{
+	static const char * const names[NR_MEMBERS] = { "m0", "m1", "m2", "m3" };
+	struct test_codec members[NR_MEMBERS], outsider;
+	pthread_t threads[NR_MEMBERS], churn, outsider_thread;
+	int i, ret;
+
+	for (i = 0; i < NR_MEMBERS; i++) {
+		ret = test_codec_probe(&members[i], names[i], &mclk,
+				       member_props);
+		CHECK(!ret, "probe: %d", ret);
+		if (ret)
+			return;
+		members[i].dai->driver->ops->set_sysclk(members[i].dai,
+							WM8960_SYSCLK_AUTO,
+							mclk.rate, 0);
+	}
+
+	ret = test_codec_probe(&outsider, "outsider", &mclk, NULL);
+	CHECK(!ret, "probe: %d", ret);
+	if (ret)
+		return;
+	outsider.dai->driver->ops->set_sysclk(outsider.dai, WM8960_SYSCLK_AUTO,
+					      mclk.rate, 0);
+
+	pthread_create(&churn, NULL, test_churn, NULL);
+	pthread_create(&outsider_thread, NULL, test_outsider, &outsider);
+	for (i = 0; i < NR_MEMBERS; i++)
+		pthread_create(&threads[i], NULL, test_member, &members[i]);
+
+	for (i = 0; i < NR_MEMBERS; i++)
+		pthread_join(threads[i], NULL);
+	pthread_join(outsider_thread, NULL);
+	churning = false;
+	pthread_join(churn, NULL);
+
+	CHECK(overlaps, "the members never ran together");
+	CHECK(conflicts, "the members never ran into each other");
+	CHECK(!mclk.enabled, "MCLK left enabled %d times", mclk.enabled);
+
+	for (i = 0; i < NR_MEMBERS; i++)
+		test_codec_remove(&members[i]);
+	test_codec_remove(&outsider);
+	CHECK(list_empty(&wm8960_clk_domains), "domain left behind");
+}
+
+int main(void)
+{
+	test_domain_mclk_mismatch();
+	test_domain_mclk_rate();
+	test_domain_keep_warm();
+	test_domain_stress();
+
+	return test_result("clk_domain_test");
+}
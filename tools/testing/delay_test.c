@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Filter delay reported through .delay, against the group delays of the
+ * digital filter characteristics in the datasheet: 23/fs for the ADC,
+ * 11/fs for the DAC and 4.6/fs for the DAC with the sloping stopband.
+ * Each direction reports its own delay in frames of its own stream, and
+ * none while it is not set up. .delay runs under the stream lock, where
+ * registers must not be read.
+ */
+
+#include "../../wm8960.c"
+#include "test.h"
+
+static struct clk mclk = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.rate = 12288000,
+};
+
+static struct snd_pcm_substream playback = {
+	.stream = SNDRV_PCM_STREAM_PLAYBACK,
+};
+
+static struct snd_pcm_substream capture = {
+	.stream = SNDRV_PCM_STREAM_CAPTURE,
+};
+
+static snd_pcm_sframes_t test_delay(struct test_codec *tc,
+				    struct snd_pcm_substream *substream)
+{
+	snd_pcm_sframes_t delay;
+
+	shim_atomic = true;
+	delay = tc->dai->driver->ops->delay(substream, tc->dai);
+	shim_atomic = false;
+
+	return delay;
+}
+
+static void test_hw_params(struct test_codec *tc,
+			   struct snd_pcm_substream *substream,
+			   unsigned int rate)
+{
+	struct snd_pcm_hw_params params;
+	int ret;
+
+	test_params(&params, SNDRV_PCM_FORMAT_S16_LE, rate, 2);
+	ret = tc->dai->driver->ops->hw_params(substream, &params, tc->dai);
+	CHECK(!ret, "%u Hz: hw_params: %d", rate, ret);
+}
+
+/* Each direction reports its own filter, and only while it is set up */
+static void test_delay_directions(struct test_codec *tc)
+{
+	const struct snd_soc_dai_ops *ops = tc->dai->driver->ops;
+
+	CHECK(test_delay(tc, &playback) == 0 && test_delay(tc, &capture) == 0,
+	      "delay %ld/%ld before hw_params", test_delay(tc, &playback),
+	      test_delay(tc, &capture));
+
+	test_hw_params(tc, &playback, 48000);
+	CHECK(test_delay(tc, &playback) == 11, "playback delay %ld",
+	      test_delay(tc, &playback));
+	CHECK(test_delay(tc, &capture) == 0,
+	      "capture delay %ld without a capture stream",
+	      test_delay(tc, &capture));
+
+	test_hw_params(tc, &capture, 48000);
+	CHECK(test_delay(tc, &capture) == 23, "capture delay %ld",
+	      test_delay(tc, &capture));
+	CHECK(test_delay(tc, &playback) == 11,
+	      "playback delay %ld alongside capture",
+	      test_delay(tc, &playback));
+
+	ops->hw_free(&playback, tc->dai);
+	CHECK(test_delay(tc, &playback) == 0, "delay %ld after hw_free",
+	      test_delay(tc, &playback));
+	CHECK(test_delay(tc, &capture) == 23,
+	      "capture delay %ld after playback hw_free",
+	      test_delay(tc, &capture));
+
+	ops->hw_free(&capture, tc->dai);
+	CHECK(test_delay(tc, &capture) == 0, "delay %ld after hw_free",
+	      test_delay(tc, &capture));
+}
+
+/* Switching the DAC filter while streaming changes the delay at once */
+static void test_delay_slope_switch(struct test_codec *tc)
+{
+	const struct snd_soc_dai_ops *ops = tc->dai->driver->ops;
+
+	test_put_control(tc, "DAC Sloping Stopband Filter Switch", 0);
+	test_hw_params(tc, &playback, 48000);
+	test_hw_params(tc, &capture, 48000);
+	CHECK(test_delay(tc, &playback) == 11, "delay %ld",
+	      test_delay(tc, &playback));
+
+	test_put_control(tc, "DAC Sloping Stopband Filter Switch", 1);
+	CHECK(test_delay(tc, &playback) == 5, "delay %ld after switching on",
+	      test_delay(tc, &playback));
+	CHECK(test_delay(tc, &capture) == 23,
+	      "capture delay %ld after switching the DAC filter",
+	      test_delay(tc, &capture));
+
+	test_put_control(tc, "DAC Sloping Stopband Filter Switch", 0);
+	CHECK(test_delay(tc, &playback) == 11, "delay %ld after switching off",
+	      test_delay(tc, &playback));
+
+	ops->hw_free(&capture, tc->dai);
+	ops->hw_free(&playback, tc->dai);
+}
+
+/* With separate frame clocks the ADC delay is in capture frames */
+static void test_delay_asymmetric(void)
+{
+	static const struct property props[] = {
+		{ "wlf,asymmetric-rates", NULL, 0 },
+		{ }
+	};
+	const struct snd_soc_dai_ops *ops;
+	struct test_codec tc;
+	int ret;
+
+	ret = test_codec_probe(&tc, "asym", &mclk, props);
+	CHECK(!ret, "probe: %d", ret);
+	if (ret)
+		return;
+	ops = tc.dai->driver->ops;
+	ops->set_sysclk(tc.dai, WM8960_SYSCLK_AUTO, mclk.rate, 0);
+
+	test_hw_params(&tc, &playback, 48000);
+	test_hw_params(&tc, &capture, 16000);
+	ret = shim_set_bias_level(tc.component, SND_SOC_BIAS_ON);
+	CHECK(!ret, "bias ON: %d", ret);
+	CHECK(tc.wm8960->adc_lrclk == 16000, "ADC clocked at %d Hz",
+	      tc.wm8960->adc_lrclk);
+
+	CHECK(test_delay(&tc, &playback) == 11, "playback delay %ld at 48 kHz",
+	      test_delay(&tc, &playback));
+	CHECK(test_delay(&tc, &capture) == 23, "capture delay %ld at 16 kHz",
+	      test_delay(&tc, &capture));
+
+	shim_set_bias_level(tc.component, SND_SOC_BIAS_STANDBY);
+	ops->hw_free(&capture, tc.dai);
+	ops->hw_free(&playback, tc.dai);
+
+	test_codec_remove(&tc);
+}
+
+int main(void)
+{
+	struct test_codec tc;
+	int ret;
+
+	ret = test_codec_probe(&tc, "wm8960", &mclk, NULL);
+	CHECK(!ret, "probe: %d", ret);
+	if (ret)
+		return test_result("delay_test");
+
+	tc.dai->driver->ops->set_sysclk(tc.dai, WM8960_SYSCLK_AUTO, mclk.rate, 0);
+
+	test_delay_directions(&tc);
+	test_delay_slope_switch(&tc);
+
+	test_codec_remove(&tc);
+
+	test_delay_asymmetric();
+
+	return test_result("delay_test");
+}
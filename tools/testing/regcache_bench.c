@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Register cache benchmark: the cost of cached reads and update_bits and
+ * the cache memory, for the flat cache the driver uses and the RBTREE
+ * cache it used before. Both run on scratch register maps with the
+ * driver's layout and defaults, in cache only mode so that the bus is
+ * left out. The RBTREE cache is the shim's model of regcache-rbtree.c,
+ * so the figures compare the two layouts rather than a given kernel.
+ */
+
+#include <time.h>
+
+#include "../../wm8960.c"
+#include "test.h"
+
+#define LOOPS	1000000
+
+static int bench_reg_write(void *context, unsigned int reg, unsigned int val)
+{
+	return 0;
+}
+
+static const struct regmap_bus bench_bus = {
+	.reg_write = bench_reg_write,
+};
+
+static u64 bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_cache(enum regcache_type type, const char *name)
+{
+	struct regmap_config config = wm8960_regmap;
+	struct device dev = { .name = name };
+	struct regmap *map;
+	unsigned int i, reg, val;
+	u64 start, read_ns, update_ns;
+
+	config.cache_type = type;
+
+	map = regmap_init(&dev, &bench_bus, NULL, &config);
+	CHECK(!IS_ERR(map), "%s: regmap_init: %ld", name, PTR_ERR(map));
+	if (IS_ERR(map))
+		return;
+	regcache_cache_only(map, true);
+
+	/* Both caches start out from the defaults */
+	for (i = 0; i < ARRAY_SIZE(wm8960_reg_defaults); i++) {
+		reg = wm8960_reg_defaults[i].reg;
+		regmap_read(map, reg, &val);
+		CHECK(val == wm8960_reg_defaults[i].def,
+		      "%s: R%u reads %#x", name, reg, val);
+	}
+
+	start = bench_now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		reg = wm8960_reg_defaults[i % ARRAY_SIZE(wm8960_reg_defaults)].reg;
+		regmap_read(map, reg, &val);
+	}
+	read_ns = bench_now_ns() - start;
+
+	start = bench_now_ns();
+	for (i = 0; i < LOOPS; i++) {
+		reg = wm8960_reg_defaults[i % ARRAY_SIZE(wm8960_reg_defaults)].reg;
+		regmap_update_bits(map, reg, 0x1, i & 0x1);
+	}
+	update_ns = bench_now_ns() - start;
+
+	printf("%-6s %8.1f %12.1f %8zu\n", name, (double)read_ns / LOOPS,
+	       (double)update_ns / LOOPS, shim_regcache_size(map));
+
+	regmap_exit(map);
+}
+
+int main(void)
+{
+	printf("cache  read(ns)   update(ns)    bytes\n");
+	bench_cache(REGCACHE_FLAT, "flat");
+	bench_cache(REGCACHE_RBTREE, "rbtree");
+
+	return test_result("regcache_bench");
+}
@@ -0,0 +1,981 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Userspace implementations behind shim.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "shim.h"
+
+bool shim_verbose;
+
+void shim_log(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (!shim_verbose)
+		return;
+
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+/* Completions */
+void init_completion(struct completion *c)
+{
+	pthread_mutex_init(&c->m, NULL);
+	pthread_cond_init(&c->c, NULL);
+	c->done = false;
+}
+
+void reinit_completion(struct completion *c)
+{
+	pthread_mutex_lock(&c->m);
+	c->done = false;
+	pthread_mutex_unlock(&c->m);
+}
+
+void complete_all(struct completion *c)
+{
+	pthread_mutex_lock(&c->m);
+	c->done = true;
+	pthread_cond_broadcast(&c->c);
+	pthread_mutex_unlock(&c->m);
+}
+
+void wait_for_completion(struct completion *c)
+{
+	pthread_mutex_lock(&c->m);
+	while (!c->done)
+		pthread_cond_wait(&c->c, &c->m);
+	pthread_mutex_unlock(&c->m);
+}
+
+/* Virtual time */
+static _Atomic s64 shim_now;
+
+ktime_t ktime_get(void)
+{
+	return atomic_fetch_add(&shim_now, 1);
+}
+
+void msleep(unsigned int ms)
+{
+	atomic_fetch_add(&shim_now, ms * NSEC_PER_MSEC);
+}
+
+void usleep_range(unsigned long min, unsigned long max)
+{
+	atomic_fetch_add(&shim_now, min * NSEC_PER_USEC);
+}
+
+/* Work items */
+void *system_wq;
+__thread bool shim_defer_work;
+
+bool mod_delayed_work(void *wq, struct delayed_work *dwork,
+		      unsigned long delay)
+{
+	bool pending = dwork->pending;
+
+	dwork->pending = shim_defer_work;
+	if (!dwork->pending) {
+		msleep(delay);
+		dwork->work.func(&dwork->work);
+	}
+
+	return pending;
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dwork)
+{
+	bool pending = dwork->pending;
+
+	dwork->pending = false;
+
+	return pending;
+}
+
+void shim_flush_delayed_work(struct delayed_work *dwork)
+{
+	if (!cancel_delayed_work_sync(dwork))
+		return;
+
+	dwork->work.func(&dwork->work);
+}
+
+/* Managed resources */
+struct shim_devres {
+	struct shim_devres *next;
+	void (*action)(void *data);
+	void *data;
+};
+
+void *kzalloc(size_t size, gfp_t gfp)
+{
+	return calloc(1, size);
+}
+
+void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+static int shim_devres_add(struct device *dev, void (*action)(void *),
+			   void *data)
+{
+	struct shim_devres *dr = calloc(1, sizeof(*dr));
+
+	if (!dr)
+		return -ENOMEM;
+
+	dr->action = action;
+	dr->data = data;
+	dr->next = dev->devres;
+	dev->devres = dr;
+
+	return 0;
+}
+
+static void shim_devres_free(void *data)
+{
+	free(data);
+}
+
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp)
+{
+	void *p = calloc(1, size);
+
+	if (p && shim_devres_add(dev, shim_devres_free, p)) {
+		free(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void *devm_kmemdup(struct device *dev, const void *src, size_t len,
+		   gfp_t gfp)
+{
+	void *p = devm_kzalloc(dev, len, gfp);
+
+	if (p)
+		memcpy(p, src, len);
+
+	return p;
+}
+
+int devm_add_action_or_reset(struct device *dev, void (*action)(void *),
+			     void *data)
+{
+	int ret = shim_devres_add(dev, action, data);
+
+	if (ret)
+		action(data);
+
+	return ret;
+}
+
+void shim_device_release(struct device *dev)
+{
+	struct shim_devres *dr;
+
+	while ((dr = dev->devres)) {
+		dev->devres = dr->next;
+		dr->action(dr->data);
+		free(dr);
+	}
+	dev->driver_data = NULL;
+	dev->regmap = NULL;
+	dev->component = NULL;
+}
+
+/* Device tree */
+static const struct property *of_find_property(const struct device_node *np,
+					       const char *name)
+{
+	const struct property *pp;
+
+	if (!np || !np->properties)
+		return NULL;
+
+	for (pp = np->properties; pp->name; pp++)
+		if (!strcmp(pp->name, name))
+			return pp;
+
+	return NULL;
+}
+
+bool of_property_read_bool(const struct device_node *np, const char *name)
+{
+	return of_find_property(np, name);
+}
+
+int of_property_count_u32_elems(const struct device_node *np,
+				const char *name)
+{
+	const struct property *pp = of_find_property(np, name);
+
+	return pp ? pp->length : -EINVAL;
+}
+
+int of_property_read_u32_array(const struct device_node *np,
+			       const char *name, u32 *out, size_t sz)
+{
+	const struct property *pp = of_find_property(np, name);
+
+	if (!pp)
+		return -EINVAL;
+	if (pp->length < sz)
+		return -EOVERFLOW;
+
+	memcpy(out, pp->value, sz * sizeof(*out));
+
+	return 0;
+}
+
+int of_property_read_u32(const struct device_node *np, const char *name,
+			 u32 *out)
+{
+	return of_property_read_u32_array(np, name, out, 1);
+}
+
+/* Clocks */
+struct clk *devm_clk_get(struct device *dev, const char *id)
+{
+	return dev->clk ? dev->clk : ERR_PTR(-ENOENT);
+}
+
+int clk_prepare_enable(struct clk *clk)
+{
+	pthread_mutex_lock(&clk->lock);
+	clk->enabled++;
+	pthread_mutex_unlock(&clk->lock);
+
+	return 0;
+}
+
+void clk_disable_unprepare(struct clk *clk)
+{
+	pthread_mutex_lock(&clk->lock);
+	clk->enabled--;
+	pthread_mutex_unlock(&clk->lock);
+}
+
+unsigned long clk_get_rate(struct clk *clk)
+{
+	unsigned long rate;
+
+	pthread_mutex_lock(&clk->lock);
+	rate = clk->rate;
+	pthread_mutex_unlock(&clk->lock);
+
+	return rate;
+}
+
+int clk_set_rate(struct clk *clk, unsigned long rate)
+{
+	int i, ret = -EINVAL;
+
+	pthread_mutex_lock(&clk->lock);
+	for (i = 0; i < clk->num_rates; i++) {
+		if (clk->rates[i] == rate) {
+			clk->rate = rate;
+			ret = 0;
+		}
+	}
+	pthread_mutex_unlock(&clk->lock);
+
+	return ret;
+}
+
+/* I2C */
+static int shim_i2c_write(struct i2c_adapter *adap, const u8 *buf)
+{
+	if (adap->fail) {
+		adap->fail--;
+		return -EIO;
+	}
+
+	adap->regs[buf[0] >> 1] = ((buf[0] & 0x1) << 8) | buf[1];
+	adap->writes++;
+
+	return 0;
+}
+
+int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num)
+{
+	int i, ret = num;
+
+	pthread_mutex_lock(&adap->lock);
+	adap->transfers++;
+	for (i = 0; i < num; i++) {
+		if (shim_i2c_write(adap, msgs[i].buf)) {
+			ret = -EIO;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&adap->lock);
+
+	return ret;
+}
+
+int i2c_master_send(const struct i2c_client *client, const char *buf,
+		    int count)
+{
+	struct i2c_adapter *adap = client->adapter;
+	int ret;
+
+	pthread_mutex_lock(&adap->lock);
+	adap->transfers++;
+	ret = shim_i2c_write(adap, (const u8 *)buf);
+	pthread_mutex_unlock(&adap->lock);
+
+	return ret ? ret : count;
+}
+
+s32 i2c_smbus_write_byte_data(const struct i2c_client *client, u8 command,
+			      u8 value)
+{
+	u8 buf[2] = { command, value };
+
+	return i2c_master_send(client, (const char *)buf, 2) < 0 ? -EIO : 0;
+}
+
+/*
+ * Register maps, written through to the bus. REGCACHE_RBTREE keeps the
+ * block layout and lookup of regcache-rbtree.c, in an unbalanced tree,
+ * so that regcache_bench can compare it with the flat cache. Any other
+ * cache type is flat.
+ */
+struct shim_rbnode {
+	u16 *block;
+	unsigned long *cache_present;
+	unsigned int base_reg;
+	unsigned int blklen;
+	/* in place of struct rb_node */
+	struct shim_rbnode *parent, *left, *right;
+};
+
+struct regmap {
+	pthread_mutex_t lock;
+	struct device *dev;
+	const struct regmap_bus *bus;
+	void *context;
+	struct regmap_config config;
+	unsigned int *cache;
+	struct shim_rbnode *rb_root;
+	struct shim_rbnode *rb_cached;
+	bool cache_only;
+	bool dirty;
+};
+
+__thread bool shim_atomic;
+
+/* Register access may sleep on the bus lock */
+static void regmap_might_sleep(void)
+{
+	if (shim_atomic) {
+		fprintf(stderr, "register access in atomic context\n");
+		abort();
+	}
+}
+
+static unsigned int regmap_default(struct regmap *map, unsigned int reg)
+{
+	unsigned int i;
+
+	for (i = 0; i < map->config.num_reg_defaults; i++)
+		if (map->config.reg_defaults[i].reg == reg)
+			return map->config.reg_defaults[i].def;
+
+	return 0;
+}
+
+static bool regcache_rbtree(struct regmap *map)
+{
+	return map->config.cache_type == REGCACHE_RBTREE;
+}
+
+static struct shim_rbnode *regcache_rbtree_lookup(struct regmap *map,
+						  unsigned int reg)
+{
+	struct shim_rbnode *node = map->rb_cached;
+
+	if (node && reg >= node->base_reg &&
+	    reg < node->base_reg + node->blklen)
+		return node;
+
+	node = map->rb_root;
+	while (node) {
+		if (reg < node->base_reg) {
+			node = node->left;
+		} else if (reg >= node->base_reg + node->blklen) {
+			node = node->right;
+		} else {
+			map->rb_cached = node;
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+/* Grow a block to cover reg, as regcache_rbtree_insert_to_block() does */
+static int regcache_rbtree_extend(struct shim_rbnode *node, unsigned int reg)
+{
+	unsigned int base = reg, top = reg;
+	unsigned int len, shift;
+	unsigned long *present;
+	u16 *block;
+	unsigned int i;
+
+	if (node->blklen) {
+		base = min(node->base_reg, reg);
+		top = max(node->base_reg + node->blklen - 1, reg);
+	}
+	len = top - base + 1;
+	shift = node->base_reg - base;
+
+	block = calloc(len, sizeof(*block));
+	present = calloc(BITS_TO_LONGS(len), sizeof(*present));
+	if (!block || !present) {
+		free(block);
+		free(present);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < node->blklen; i++) {
+		block[i + shift] = node->block[i];
+		if (node->cache_present[i / BITS_PER_LONG] &
+		    (1UL << (i % BITS_PER_LONG)))
+			present[(i + shift) / BITS_PER_LONG] |=
+				1UL << ((i + shift) % BITS_PER_LONG);
+	}
+
+	free(node->block);
+	free(node->cache_present);
+	node->block = block;
+	node->cache_present = present;
+	node->base_reg = base;
+	node->blklen = len;
+
+	return 0;
+}
+
+static int regcache_rbtree_write(struct regmap *map, unsigned int reg,
+				 unsigned int val)
+{
+	/* registers this close to a block are added to it, like the kernel */
+	const unsigned int max_dist = sizeof(struct shim_rbnode) / sizeof(u16);
+	struct shim_rbnode *node = regcache_rbtree_lookup(map, reg);
+	struct shim_rbnode **link, *parent = NULL;
+	unsigned int idx;
+
+	if (!node) {
+		for (link = &map->rb_root; *link; ) {
+			parent = *link;
+			if (reg + max_dist >= parent->base_reg &&
+			    reg <= parent->base_reg + parent->blklen - 1 +
+				   max_dist) {
+				node = parent;
+				break;
+			}
+			link = reg < parent->base_reg ? &parent->left :
+							&parent->right;
+		}
+
+		if (!node) {
+			node = calloc(1, sizeof(*node));
+			if (!node)
+				return -ENOMEM;
+			node->base_reg = reg;
+			node->parent = parent;
+			*link = node;
+		}
+
+		if (regcache_rbtree_extend(node, reg))
+			return -ENOMEM;
+		map->rb_cached = node;
+	}
+
+	idx = reg - node->base_reg;
+	node->block[idx] = val;
+	node->cache_present[idx / BITS_PER_LONG] |= 1UL << (idx % BITS_PER_LONG);
+
+	return 0;
+}
+
+static void regcache_rbtree_exit(struct shim_rbnode *node)
+{
+	if (!node)
+		return;
+
+	regcache_rbtree_exit(node->left);
+	regcache_rbtree_exit(node->right);
+	free(node->block);
+	free(node->cache_present);
+	free(node);
+}
+
+static unsigned int regcache_read(struct regmap *map, unsigned int reg)
+{
+	struct shim_rbnode *node;
+
+	if (!regcache_rbtree(map))
+		return map->cache[reg];
+
+	node = regcache_rbtree_lookup(map, reg);
+
+	return node ? node->block[reg - node->base_reg] : 0;
+}
+
+static int regcache_write(struct regmap *map, unsigned int reg,
+			  unsigned int val)
+{
+	if (regcache_rbtree(map))
+		return regcache_rbtree_write(map, reg, val);
+
+	map->cache[reg] = val;
+
+	return 0;
+}
+
+static size_t regcache_rbtree_size(const struct shim_rbnode *node)
+{
+	if (!node)
+		return 0;
+
+	return sizeof(*node) + node->blklen * sizeof(u16) +
+	       BITS_TO_LONGS(node->blklen) * sizeof(long) +
+	       regcache_rbtree_size(node->left) +
+	       regcache_rbtree_size(node->right);
+}
+
+/* Cache memory as the regmap core allocates it */
+size_t shim_regcache_size(struct regmap *map)
+{
+	if (regcache_rbtree(map))
+		return 2 * sizeof(void *) + regcache_rbtree_size(map->rb_root);
+
+	return (map->config.max_register + 1) * sizeof(*map->cache);
+}
+
+static bool regmap_volatile(struct regmap *map, unsigned int reg)
+{
+	return map->config.volatile_reg &&
+	       map->config.volatile_reg(map->dev, reg);
+}
+
+struct regmap *regmap_init(struct device *dev, const struct regmap_bus *bus,
+			   void *context, const struct regmap_config *config)
+{
+	struct regmap *map = calloc(1, sizeof(*map));
+	unsigned int i;
+
+	if (!map)
+		return ERR_PTR(-ENOMEM);
+
+	pthread_mutex_init(&map->lock, NULL);
+	map->dev = dev;
+	map->bus = bus;
+	map->context = context;
+	map->config = *config;
+
+	if (!regcache_rbtree(map)) {
+		map->cache = calloc(config->max_register + 1,
+				    sizeof(*map->cache));
+		if (!map->cache) {
+			free(map);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+
+	for (i = 0; i < config->num_reg_defaults; i++) {
+		if (regcache_write(map, config->reg_defaults[i].reg,
+				   config->reg_defaults[i].def)) {
+			regmap_exit(map);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+
+	return map;
+}
+
+void regmap_exit(struct regmap *map)
+{
+	regcache_rbtree_exit(map->rb_root);
+	free(map->cache);
+	free(map);
+}
+
+static void shim_regmap_exit(void *data)
+{
+	regmap_exit(data);
+}
+
+struct regmap *devm_regmap_init(struct device *dev,
+				const struct regmap_bus *bus, void *context,
+				const struct regmap_config *config)
+{
+	struct regmap *map = regmap_init(dev, bus, context, config);
+
+	if (IS_ERR(map))
+		return map;
+	if (devm_add_action_or_reset(dev, shim_regmap_exit, map))
+		return ERR_PTR(-ENOMEM);
+
+	dev->regmap = map;
+
+	return map;
+}
+
+static int _regmap_write(struct regmap *map, unsigned int reg,
+			 unsigned int val)
+{
+	int ret;
+
+	if (reg > map->config.max_register)
+		return -EINVAL;
+
+	/* like regmap, the cache is updated before the bus is written */
+	if (!regmap_volatile(map, reg)) {
+		ret = regcache_write(map, reg, val);
+		if (ret)
+			return ret;
+		if (map->cache_only) {
+			map->dirty = true;
+			return 0;
+		}
+	}
+
+	return map->bus->reg_write(map->context, reg, val);
+}
+
+int regmap_write(struct regmap *map, unsigned int reg, unsigned int val)
+{
+	int ret;
+
+	regmap_might_sleep();
+
+	pthread_mutex_lock(&map->lock);
+	ret = _regmap_write(map, reg, val);
+	pthread_mutex_unlock(&map->lock);
+
+	return ret;
+}
+
+int regmap_read(struct regmap *map, unsigned int reg, unsigned int *val)
+{
+	regmap_might_sleep();
+
+	if (reg > map->config.max_register || regmap_volatile(map, reg))
+		return -EINVAL;
+
+	pthread_mutex_lock(&map->lock);
+	*val = regcache_read(map, reg);
+	pthread_mutex_unlock(&map->lock);
+
+	return 0;
+}
+
+static int regmap_update_bits_check(struct regmap *map, unsigned int reg,
+				    unsigned int mask, unsigned int val,
+				    bool *change)
+{
+	unsigned int old, new;
+	int ret = 0;
+
+	regmap_might_sleep();
+
+	if (reg > map->config.max_register)
+		return -EINVAL;
+
+	pthread_mutex_lock(&map->lock);
+	old = regcache_read(map, reg);
+	new = (old & ~mask) | (val & mask);
+	*change = new != old;
+	if (*change)
+		ret = _regmap_write(map, reg, new);
+	pthread_mutex_unlock(&map->lock);
+
+	return ret;
+}
+
+int regmap_update_bits(struct regmap *map, unsigned int reg,
+		       unsigned int mask, unsigned int val)
+{
+	bool change;
+
+	return regmap_update_bits_check(map, reg, mask, val, &change);
+}
+
+int regcache_sync(struct regmap *map)
+{
+	unsigned int reg;
+	int ret = 0;
+
+	pthread_mutex_lock(&map->lock);
+	if (map->dirty && !map->cache_only) {
+		/* registers at their default value are skipped */
+		for (reg = 0; reg <= map->config.max_register && !ret; reg++) {
+			if (regmap_volatile(map, reg) ||
+			    (map->config.writeable_reg &&
+			     !map->config.writeable_reg(map->dev, reg)) ||
+			    regcache_read(map, reg) == regmap_default(map, reg))
+				continue;
+			ret = map->bus->reg_write(map->context, reg,
+						  regcache_read(map, reg));
+		}
+		if (!ret)
+			map->dirty = false;
+	}
+	pthread_mutex_unlock(&map->lock);
+
+	return ret;
+}
+
+void regcache_cache_only(struct regmap *map, bool enable)
+{
+	pthread_mutex_lock(&map->lock);
+	map->cache_only = enable;
+	pthread_mutex_unlock(&map->lock);
+}
+
+void regcache_mark_dirty(struct regmap *map)
+{
+	pthread_mutex_lock(&map->lock);
+	map->dirty = true;
+	pthread_mutex_unlock(&map->lock);
+}
+
+int snd_soc_get_volsw(struct snd_kcontrol *kcontrol,
+		      struct snd_ctl_elem_value *ucontrol)
+{
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+	struct snd_soc_component *c = snd_soc_kcontrol_component(kcontrol);
+	unsigned int mask = (1 << fls(mc->max)) - 1;
+	unsigned int val;
+
+	val = (snd_soc_component_read(c, mc->reg) >> mc->shift) & mask;
+	if (mc->invert)
+		val = mc->max - val;
+	ucontrol->value.integer.value[0] = val;
+
+	return 0;
+}
+
+int snd_soc_put_volsw(struct snd_kcontrol *kcontrol,
+		      struct snd_ctl_elem_value *ucontrol)
+{
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+	struct snd_soc_component *c = snd_soc_kcontrol_component(kcontrol);
+	unsigned int mask = (1 << fls(mc->max)) - 1;
+	long val = ucontrol->value.integer.value[0];
+
+	if (val < 0 || val > mc->max)
+		return -EINVAL;
+	if (mc->invert)
+		val = mc->max - val;
+
+	return snd_soc_component_update_bits(c, mc->reg, mask << mc->shift,
+					     val << mc->shift);
+}
+
+int seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+	return 0;
+}
+
+int seq_puts(struct seq_file *m, const char *s)
+{
+	return 0;
+}
+
+/* PCM */
+int snd_pcm_format_width(snd_pcm_format_t format)
+{
+	switch (format) {
+	case SNDRV_PCM_FORMAT_MU_LAW:
+	case SNDRV_PCM_FORMAT_A_LAW:
+		return 8;
+	case SNDRV_PCM_FORMAT_S16_LE:
+		return 16;
+	case SNDRV_PCM_FORMAT_S20_3LE:
+		return 20;
+	case SNDRV_PCM_FORMAT_S24_LE:
+	case SNDRV_PCM_FORMAT_S24_3LE:
+		return 24;
+	case SNDRV_PCM_FORMAT_S32_LE:
+		return 32;
+	default:
+		return -EINVAL;
+	}
+}
+
+int snd_interval_list(struct snd_interval *i, unsigned int count,
+		      const unsigned int *list, unsigned int mask)
+{
+	unsigned int k, lo = UINT_MAX, hi = 0;
+
+	for (k = 0; k < count; k++) {
+		if (!snd_interval_test(i, list[k]))
+			continue;
+		lo = min(lo, list[k]);
+		hi = max(hi, list[k]);
+	}
+	if (lo > hi)
+		return -EINVAL;
+
+	i->min = lo;
+	i->max = hi;
+
+	return 0;
+}
+
+int snd_mask_refine(struct snd_mask *m, const struct snd_mask *v)
+{
+	u64 old = m->bits;
+
+	m->bits &= v->bits;
+	if (!m->bits)
+		return -EINVAL;
+
+	return m->bits != old;
+}
+
+int snd_pcm_hw_rule_add(struct snd_pcm_runtime *runtime, unsigned int cond,
+			int var,
+			int (*func)(struct snd_pcm_hw_params *params,
+				    struct snd_pcm_hw_rule *rule),
+			void *private, int dep, ...)
+{
+	return 0;
+}
+
+int snd_pcm_hw_constraint_list(struct snd_pcm_runtime *runtime,
+			       unsigned int cond, int var,
+			       const struct snd_pcm_hw_constraint_list *l)
+{
+	return 0;
+}
+
+/* Components */
+unsigned int snd_soc_component_read(struct snd_soc_component *c,
+				    unsigned int reg)
+{
+	unsigned int val = 0;
+
+	regmap_read(c->regmap, reg, &val);
+
+	return val;
+}
+
+int snd_soc_component_write(struct snd_soc_component *c, unsigned int reg,
+			    unsigned int val)
+{
+	return regmap_write(c->regmap, reg, val);
+}
+
+int snd_soc_component_update_bits(struct snd_soc_component *c,
+				  unsigned int reg, unsigned int mask,
+				  unsigned int val)
+{
+	bool change;
+	int ret;
+
+	ret = regmap_update_bits_check(c->regmap, reg, mask, val, &change);
+	if (ret < 0)
+		return ret;
+
+	return change;
+}
+
+int snd_soc_add_component_controls(struct snd_soc_component *c,
+				   const struct snd_kcontrol_new *controls,
+				   unsigned int num_controls)
+{
+	return 0;
+}
+
+static struct snd_soc_card shim_card = {
+	.widgets = { &shim_card.widgets, &shim_card.widgets },
+};
+
+static void shim_component_free(void *data)
+{
+	struct snd_soc_component *c = data;
+
+	free(c->dai);
+	free(c);
+}
+
+int devm_snd_soc_register_component(struct device *dev,
+		const struct snd_soc_component_driver *component_driver,
+		struct snd_soc_dai_driver *dai_drv, int num_dai)
+{
+	struct snd_soc_component *c = calloc(1, sizeof(*c));
+
+	if (!c)
+		return -ENOMEM;
+
+	c->dai = calloc(1, sizeof(*c->dai));
+	if (!c->dai) {
+		free(c);
+		return -ENOMEM;
+	}
+
+	c->dev = dev;
+	c->card = &shim_card;
+	c->regmap = dev->regmap;
+	c->driver = component_driver;
+	c->bias_level = SND_SOC_BIAS_OFF;
+	c->dai->component = c;
+	c->dai->dev = dev;
+	c->dai->driver = dai_drv;
+	dev->component = c;
+
+	return devm_add_action_or_reset(dev, shim_component_free, c);
+}
+
+/* Bind the component to a card the way ASoC does before any stream */
+struct snd_soc_component *shim_probe_component(struct device *dev)
+{
+	struct snd_soc_component *c = dev->component;
+	int ret;
+
+	ret = c->driver->probe(c);
+	if (ret)
+		return ERR_PTR(ret);
+
+	ret = shim_set_bias_level(c, SND_SOC_BIAS_STANDBY);
+	if (ret)
+		return ERR_PTR(ret);
+
+	return c;
+}
+
+/* Move one level at a time, as DAPM does */
+int shim_set_bias_level(struct snd_soc_component *c,
+			enum snd_soc_bias_level level)
+{
+	int ret;
+
+	while (c->bias_level != level) {
+		enum snd_soc_bias_level next = c->bias_level < level ?
+					       c->bias_level + 1 :
+					       c->bias_level - 1;
+
+		ret = c->driver->set_bias_level(c, next);
+		if (ret)
+			return ret;
+		c->bias_level = next;
+	}
+
+	return 0;
+}
@@ -0,0 +1,874 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Userspace stand-ins for the kernel, regmap and ASoC interfaces used by
+ * wm8960.c, so that the driver can be built and exercised on the host.
+ * Only as much behaviour is modelled as the tests rely on.
+ */
+
+#ifndef _WM8960_SHIM_H
+#define _WM8960_SHIM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef unsigned int gfp_t;
+typedef s64 ktime_t;
+
+#define KERNEL_VERSION(a, b, c)	(((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE	KERNEL_VERSION(6, 1, 0)
+#define CONFIG_PM		1
+#define CONFIG_DEBUG_FS		1
+
+#define __init
+#define __exit
+#define __force
+#define __maybe_unused		__attribute__((unused))
+#define fallthrough		__attribute__((fallthrough))
+#define GFP_KERNEL		0
+
+#define ENOENT		2
+#define EIO		5
+#define EAGAIN		11
+#define ENOMEM		12
+#define EBUSY		16
+#define ENODEV		19
+#define EINVAL		22
+#define ERANGE		34
+#define EOVERFLOW	75
+#define EOPNOTSUPP	95
+#define EPROBE_DEFER	517
+#define ENOTSUPP	524
+
+#define READ_ONCE(x)		(*(volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v)	(*(volatile __typeof__(x) *)&(x) = (v))
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define BITS_PER_LONG		(8 * sizeof(long))
+#define BITS_TO_LONGS(n)	(((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)		min((t)(a), (t)(b))
+#define max_t(t, a, b)		max((t)(a), (t)(b))
+#define clamp(v, lo, hi)	min(max(v, lo), hi)
+#define clamp_t(t, v, lo, hi)	clamp((t)(v), (t)(lo), (t)(hi))
+#define abs(x)			({ __typeof__(x) __x = (x); __x < 0 ? -__x : __x; })
+#define DIV_ROUND_CLOSEST(x, d)	(((x) + ((d) / 2)) / (d))
+#define DIV_ROUND_UP(x, d)	(((x) + (d) - 1) / (d))
+#define do_div(n, base) \
+	({ u32 __rem = (n) % (base); (n) /= (base); __rem; })
+
+static inline int fls(unsigned int x) { return x ? 32 - __builtin_clz(x) : 0; }
+static inline s64 div_s64(s64 a, s32 b) { return a / b; }
+static inline s64 div64_s64(s64 a, s64 b) { return a / b; }
+
+#define IS_ERR(p)		((unsigned long)(p) > (unsigned long)-4096)
+#define PTR_ERR(p)		((long)(p))
+#define ERR_PTR(e)		((void *)(long)(e))
+
+/* Messages */
+extern bool shim_verbose;
+void shim_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+#define pr_debug(...)		do { } while (0)
+#define pr_err(...)		shim_log(__VA_ARGS__)
+#define dev_dbg(d, ...)		do { (void)(d); } while (0)
+#define dev_info(d, ...)	((void)(d), shim_log(__VA_ARGS__))
+#define dev_warn(d, ...)	((void)(d), shim_log(__VA_ARGS__))
+#define dev_err(d, ...)		((void)(d), shim_log(__VA_ARGS__))
+
+/* Module boilerplate */
+#define MODULE_DESCRIPTION(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_LICENSE(x)
+#define MODULE_DEVICE_TABLE(type, name)
+#define MODULE_PARM_DESC(name, desc)
+#define module_param(name, type, perm)
+#define module_i2c_driver(drv)
+
+/* Lists */
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD(name)		struct list_head name = { &(name), &(name) }
+
+static inline void INIT_LIST_HEAD(struct list_head *l)
+{
+	l->next = l->prev = l;
+}
+
+static inline void __list_add(struct list_head *n, struct list_head *prev,
+			      struct list_head *next)
+{
+	next->prev = n;
+	n->next = next;
+	n->prev = prev;
+	prev->next = n;
+}
+
+static inline void list_add(struct list_head *n, struct list_head *h)
+{
+	__list_add(n, h, h->next);
+}
+
+static inline void list_add_tail(struct list_head *n, struct list_head *h)
+{
+	__list_add(n, h->prev, h);
+}
+
+static inline void list_del(struct list_head *e)
+{
+	e->next->prev = e->prev;
+	e->prev->next = e->next;
+	e->next = e->prev = NULL;
+}
+
+static inline bool list_empty(const struct list_head *h)
+{
+	return h->next == h;
+}
+
+static inline bool list_is_singular(const struct list_head *h)
+{
+	return !list_empty(h) && h->next == h->prev;
+}
+
+#define list_first_entry(head, type, member) \
+	container_of((head)->next, type, member)
+#define list_for_each_entry(pos, head, member)				\
+	for (pos = container_of((head)->next, __typeof__(*pos), member);	\
+	     &pos->member != (head);						\
+	     pos = container_of(pos->member.next, __typeof__(*pos), member))
+
+/* Locking and completions */
+struct mutex {
+	pthread_mutex_t m;
+};
+
+#define DEFINE_MUTEX(name) \
+	struct mutex name = { PTHREAD_MUTEX_INITIALIZER }
+
+static inline void mutex_init(struct mutex *m)
+{
+	pthread_mutex_init(&m->m, NULL);
+}
+
+static inline void mutex_lock(struct mutex *m)
+{
+	pthread_mutex_lock(&m->m);
+}
+
+static inline void mutex_unlock(struct mutex *m)
+{
+	pthread_mutex_unlock(&m->m);
+}
+
+struct completion {
+	pthread_mutex_t m;
+	pthread_cond_t c;
+	bool done;
+};
+
+void init_completion(struct completion *c);
+void reinit_completion(struct completion *c);
+void complete_all(struct completion *c);
+void wait_for_completion(struct completion *c);
+
+/* Time: a virtual clock that sleeping moves forward */
+#define NSEC_PER_MSEC	1000000LL
+#define NSEC_PER_USEC	1000LL
+
+ktime_t ktime_get(void);
+void msleep(unsigned int ms);
+void usleep_range(unsigned long min, unsigned long max);
+
+static inline ktime_t ktime_add_ms(ktime_t k, u64 ms) { return k + ms * NSEC_PER_MSEC; }
+static inline bool ktime_before(ktime_t a, ktime_t b) { return a < b; }
+static inline s64 ktime_ms_delta(ktime_t a, ktime_t b) { return (a - b) / NSEC_PER_MSEC; }
+static inline s64 ktime_us_delta(ktime_t a, ktime_t b) { return (a - b) / NSEC_PER_USEC; }
+static inline unsigned long msecs_to_jiffies(unsigned int ms) { return ms; }
+
+/*
+ * Work items run synchronously when they are queued, unless the queueing
+ * thread sets shim_defer_work. They then stay pending until cancelled or
+ * run by shim_flush_delayed_work().
+ */
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+	work_func_t func;
+};
+
+struct delayed_work {
+	struct work_struct work;
+	bool pending;
+};
+
+extern __thread bool shim_defer_work;
+void shim_flush_delayed_work(struct delayed_work *dwork);
+
+#define INIT_DELAYED_WORK(w, f)	((w)->work.func = (f))
+#define to_delayed_work(w)	container_of(w, struct delayed_work, work)
+
+extern void *system_wq;
+bool mod_delayed_work(void *wq, struct delayed_work *dwork, unsigned long delay);
+bool cancel_delayed_work_sync(struct delayed_work *dwork);
+
+/* Devices and managed resources */
+struct device_node;
+
+struct device {
+	const char *name;
+	struct device_node *of_node;
+	void *platform_data;
+	void *driver_data;
+	struct shim_devres *devres;
+	/* what devm_clk_get() returns, set up by the test */
+	struct clk *clk;
+	/* the last register map created, handed to the component */
+	struct regmap *regmap;
+	struct snd_soc_component *component;
+};
+
+#define dev_get_platdata(d)	((d)->platform_data)
+
+static inline const char *dev_name(const struct device *dev)
+{
+	return dev->name;
+}
+
+void *kzalloc(size_t size, gfp_t gfp);
+void kfree(const void *p);
+void *devm_kzalloc(struct device *dev, size_t size, gfp_t gfp);
+void *devm_kmemdup(struct device *dev, const void *src, size_t len, gfp_t gfp);
+int devm_add_action_or_reset(struct device *dev, void (*action)(void *),
+			     void *data);
+/* Unbind: run the managed actions in reverse and free the allocations */
+void shim_device_release(struct device *dev);
+
+/* Device tree: a flat list of u32 array properties */
+struct property {
+	const char *name;
+	const u32 *value;
+	int length;
+};
+
+struct device_node {
+	const struct property *properties;
+};
+
+bool of_property_read_bool(const struct device_node *np, const char *name);
+int of_property_read_u32(const struct device_node *np, const char *name,
+			 u32 *out);
+int of_property_count_u32_elems(const struct device_node *np,
+				const char *name);
+int of_property_read_u32_array(const struct device_node *np,
+			       const char *name, u32 *out, size_t sz);
+
+/* Clocks */
+struct clk {
+	pthread_mutex_t lock;
+	unsigned long rate;
+	/* rates clk_set_rate() accepts, none for a fixed clock */
+	const unsigned long *rates;
+	int num_rates;
+	int enabled;
+};
+
+struct clk *devm_clk_get(struct device *dev, const char *id);
+int clk_prepare_enable(struct clk *clk);
+void clk_disable_unprepare(struct clk *clk);
+unsigned long clk_get_rate(struct clk *clk);
+int clk_set_rate(struct clk *clk, unsigned long rate);
+
+static inline bool clk_is_match(const struct clk *a, const struct clk *b)
+{
+	return a == b;
+}
+
+/* I2C: the adapter keeps what the codec would hold in its registers */
+#define I2C_FUNC_I2C	0x1
+
+struct i2c_adapter {
+	pthread_mutex_t lock;
+	unsigned int regs[0x38];
+	unsigned int writes;
+	unsigned int transfers;
+	/* fail this many transfers from now on */
+	int fail;
+};
+
+struct i2c_client {
+	struct device dev;
+	unsigned short addr;
+	struct i2c_adapter *adapter;
+};
+
+struct i2c_msg {
+	u16 addr;
+	u16 flags;
+	u16 len;
+	u8 *buf;
+};
+
+struct i2c_device_id {
+	char name[20];
+	unsigned long driver_data;
+};
+
+struct of_device_id {
+	char compatible[128];
+};
+
+enum probe_type {
+	PROBE_DEFAULT_STRATEGY,
+	PROBE_PREFER_ASYNCHRONOUS,
+	PROBE_FORCE_SYNCHRONOUS,
+};
+
+struct device_driver {
+	const char *name;
+	const struct of_device_id *of_match_table;
+	enum probe_type probe_type;
+};
+
+struct i2c_driver {
+	struct device_driver driver;
+	int (*probe)(struct i2c_client *client, const struct i2c_device_id *id);
+	void (*remove)(struct i2c_client *client);
+	const struct i2c_device_id *id_table;
+};
+
+static inline int i2c_check_functionality(struct i2c_adapter *adap, u32 func)
+{
+	return 1;
+}
+
+int i2c_transfer(struct i2c_adapter *adap, struct i2c_msg *msgs, int num);
+int i2c_master_send(const struct i2c_client *client, const char *buf,
+		    int count);
+s32 i2c_smbus_write_byte_data(const struct i2c_client *client, u8 command,
+			      u8 value);
+
+static inline void i2c_set_clientdata(struct i2c_client *client, void *data)
+{
+	client->dev.driver_data = data;
+}
+
+static inline void *dev_get_drvdata(const struct device *dev)
+{
+	return dev->driver_data;
+}
+
+/* Register maps */
+enum regcache_type {
+	REGCACHE_NONE,
+	REGCACHE_RBTREE,
+	REGCACHE_COMPRESSED,
+	REGCACHE_FLAT,
+};
+
+struct reg_default {
+	unsigned int reg;
+	unsigned int def;
+};
+
+struct regmap_config {
+	const char *name;
+	int reg_bits;
+	int val_bits;
+	unsigned int max_register;
+	const struct reg_default *reg_defaults;
+	unsigned int num_reg_defaults;
+	enum regcache_type cache_type;
+	bool (*volatile_reg)(struct device *dev, unsigned int reg);
+	bool (*readable_reg)(struct device *dev, unsigned int reg);
+	bool (*writeable_reg)(struct device *dev, unsigned int reg);
+};
+
+struct regmap_bus {
+	int (*reg_write)(void *context, unsigned int reg, unsigned int val);
+	int (*reg_read)(void *context, unsigned int reg, unsigned int *val);
+};
+
+struct regmap;
+
+struct regmap *regmap_init(struct device *dev, const struct regmap_bus *bus,
+			   void *context, const struct regmap_config *config);
+struct regmap *devm_regmap_init(struct device *dev,
+				const struct regmap_bus *bus, void *context,
+				const struct regmap_config *config);
+void regmap_exit(struct regmap *map);
+int regmap_write(struct regmap *map, unsigned int reg, unsigned int val);
+int regmap_read(struct regmap *map, unsigned int reg, unsigned int *val);
+int regmap_update_bits(struct regmap *map, unsigned int reg,
+		       unsigned int mask, unsigned int val);
+int regcache_sync(struct regmap *map);
+void regcache_cache_only(struct regmap *map, bool enable);
+void regcache_mark_dirty(struct regmap *map);
+/* Cache memory of a register map, for regcache_bench */
+size_t shim_regcache_size(struct regmap *map);
+
+/* Set while a thread stands in for atomic context, see regmap_read() */
+extern __thread bool shim_atomic;
+
+/* debugfs, not modelled */
+struct dentry;
+
+struct seq_file {
+	void *private;
+};
+
+int seq_printf(struct seq_file *m, const char *fmt, ...);
+int seq_puts(struct seq_file *m, const char *s);
+
+#define DEFINE_SHOW_ATTRIBUTE(__name) \
+	static const void *__name##_fops = __name##_show
+
+static inline struct dentry *debugfs_create_file(const char *name,
+		unsigned short mode, struct dentry *parent, void *data,
+		const void *fops)
+{
+	return NULL;
+}
+
+static inline void debugfs_create_u32(const char *name, unsigned short mode,
+				      struct dentry *parent, u32 *value)
+{
+}
+
+/* PCM */
+typedef int snd_pcm_format_t;
+typedef long snd_pcm_sframes_t;
+
+#define SNDRV_PCM_STREAM_PLAYBACK	0
+#define SNDRV_PCM_STREAM_CAPTURE	1
+
+#define SNDRV_PCM_FORMAT_S16_LE		2
+#define SNDRV_PCM_FORMAT_S24_LE		6
+#define SNDRV_PCM_FORMAT_S32_LE		10
+#define SNDRV_PCM_FORMAT_MU_LAW		20
+#define SNDRV_PCM_FORMAT_A_LAW		21
+#define SNDRV_PCM_FORMAT_S24_3LE	32
+#define SNDRV_PCM_FORMAT_S20_3LE	34
+#define SNDRV_PCM_FORMAT_LAST		52
+
+#define SNDRV_PCM_FMTBIT_S16_LE		(1ULL << SNDRV_PCM_FORMAT_S16_LE)
+#define SNDRV_PCM_FMTBIT_S24_LE		(1ULL << SNDRV_PCM_FORMAT_S24_LE)
+#define SNDRV_PCM_FMTBIT_S32_LE		(1ULL << SNDRV_PCM_FORMAT_S32_LE)
+#define SNDRV_PCM_FMTBIT_MU_LAW		(1ULL << SNDRV_PCM_FORMAT_MU_LAW)
+#define SNDRV_PCM_FMTBIT_A_LAW		(1ULL << SNDRV_PCM_FORMAT_A_LAW)
+#define SNDRV_PCM_FMTBIT_S24_3LE	(1ULL << SNDRV_PCM_FORMAT_S24_3LE)
+#define SNDRV_PCM_FMTBIT_S20_3LE	(1ULL << SNDRV_PCM_FORMAT_S20_3LE)
+
+#define SNDRV_PCM_RATE_CONTINUOUS	(1 << 30)
+#define SNDRV_PCM_RATE_KNOT		(1U << 31)
+
+#define SNDRV_PCM_HW_PARAM_FORMAT	1
+#define SNDRV_PCM_HW_PARAM_RATE		11
+
+struct snd_interval {
+	unsigned int min, max;
+};
+
+struct snd_mask {
+	u64 bits;
+};
+
+struct snd_pcm_hw_params {
+	struct snd_mask format;
+	struct snd_interval rate;
+	unsigned int channels;
+};
+
+struct snd_pcm_hw_rule {
+	void *private;
+};
+
+struct snd_pcm_hw_constraint_list {
+	unsigned int count;
+	const unsigned int *list;
+	unsigned int mask;
+};
+
+struct snd_pcm_runtime {
+	int unused;
+};
+
+struct snd_pcm_substream {
+	int stream;
+	struct snd_pcm_runtime *runtime;
+};
+
+int snd_pcm_format_width(snd_pcm_format_t format);
+
+static inline unsigned int params_rate(const struct snd_pcm_hw_params *p)
+{
+	return p->rate.min;
+}
+
+static inline unsigned int params_channels(const struct snd_pcm_hw_params *p)
+{
+	return p->channels;
+}
+
+static inline snd_pcm_format_t params_format(const struct snd_pcm_hw_params *p)
+{
+	return __builtin_ctzll(p->format.bits);
+}
+
+static inline int params_width(const struct snd_pcm_hw_params *p)
+{
+	return snd_pcm_format_width(params_format(p));
+}
+
+static inline struct snd_interval *hw_param_interval(struct snd_pcm_hw_params *p,
+						     int var)
+{
+	return &p->rate;
+}
+
+static inline const struct snd_interval *
+hw_param_interval_c(const struct snd_pcm_hw_params *p, int var)
+{
+	return &p->rate;
+}
+
+static inline struct snd_mask *hw_param_mask(struct snd_pcm_hw_params *p,
+					     int var)
+{
+	return &p->format;
+}
+
+static inline const struct snd_mask *
+hw_param_mask_c(const struct snd_pcm_hw_params *p, int var)
+{
+	return &p->format;
+}
+
+static inline int snd_interval_test(const struct snd_interval *i,
+				    unsigned int val)
+{
+	return val >= i->min && val <= i->max;
+}
+
+int snd_interval_list(struct snd_interval *i, unsigned int count,
+		      const unsigned int *list, unsigned int mask);
+
+static inline void snd_mask_none(struct snd_mask *m) { m->bits = 0; }
+static inline void snd_mask_set(struct snd_mask *m, unsigned int v) { m->bits |= 1ULL << v; }
+
+static inline int snd_mask_test(const struct snd_mask *m, unsigned int v)
+{
+	return v < 64 && (m->bits >> v) & 1;
+}
+
+int snd_mask_refine(struct snd_mask *m, const struct snd_mask *v);
+int snd_pcm_hw_rule_add(struct snd_pcm_runtime *runtime, unsigned int cond,
+			int var,
+			int (*func)(struct snd_pcm_hw_params *params,
+				    struct snd_pcm_hw_rule *rule),
+			void *private, int dep, ...);
+int snd_pcm_hw_constraint_list(struct snd_pcm_runtime *runtime,
+			       unsigned int cond, int var,
+			       const struct snd_pcm_hw_constraint_list *l);
+
+/* Controls */
+typedef int snd_ctl_elem_iface_t;
+
+#define SNDRV_CTL_ELEM_TYPE_BOOLEAN		1
+#define SNDRV_CTL_ELEM_TYPE_INTEGER		2
+#define SNDRV_CTL_ELEM_IFACE_MIXER		2
+#define SNDRV_CTL_ELEM_ACCESS_READ		(1 << 0)
+#define SNDRV_CTL_ELEM_ACCESS_WRITE		(1 << 1)
+#define SNDRV_CTL_ELEM_ACCESS_READWRITE		3
+#define SNDRV_CTL_ELEM_ACCESS_VOLATILE		(1 << 2)
+
+struct snd_ctl_elem_value {
+	union {
+		struct {
+			long value[128];
+		} integer;
+		struct {
+			unsigned int item[128];
+		} enumerated;
+	} value;
+};
+
+struct snd_ctl_elem_info {
+	int type;
+	unsigned int count;
+	union {
+		struct {
+			long min, max, step;
+		} integer;
+	} value;
+};
+
+struct snd_kcontrol {
+	unsigned long private_value;
+	void *private_data;
+};
+
+typedef int snd_kcontrol_info_t(struct snd_kcontrol *,
+				struct snd_ctl_elem_info *);
+typedef int snd_kcontrol_get_t(struct snd_kcontrol *,
+			       struct snd_ctl_elem_value *);
+typedef int snd_kcontrol_put_t(struct snd_kcontrol *,
+			       struct snd_ctl_elem_value *);
+
+struct snd_kcontrol_new {
+	snd_ctl_elem_iface_t iface;
+	const char *name;
+	unsigned int access;
+	snd_kcontrol_info_t *info;
+	snd_kcontrol_get_t *get;
+	snd_kcontrol_put_t *put;
+	unsigned long private_value;
+};
+
+struct soc_enum {
+	int reg;
+	unsigned char shift_l;
+	unsigned int items;
+	const char * const *texts;
+};
+
+struct soc_mixer_control {
+	int reg;
+	unsigned int shift;
+	int max;
+	unsigned int invert;
+};
+
+#define SOC_MIXER_PRIV(r, s, m, i) \
+	((unsigned long)&(struct soc_mixer_control) \
+	 { .reg = r, .shift = s, .max = m, .invert = i })
+int snd_soc_get_volsw(struct snd_kcontrol *kcontrol,
+		      struct snd_ctl_elem_value *ucontrol);
+int snd_soc_put_volsw(struct snd_kcontrol *kcontrol,
+		      struct snd_ctl_elem_value *ucontrol);
+
+#define SOC_SINGLE(xname, reg, shift, max, invert) \
+	{ .name = xname, .get = snd_soc_get_volsw, .put = snd_soc_put_volsw, \
+	  .private_value = SOC_MIXER_PRIV(reg, shift, max, invert) }
+#define SOC_SINGLE_TLV(xname, reg, shift, max, invert, tlv) \
+	SOC_SINGLE(xname, reg, shift, max, invert)
+#define SOC_DOUBLE_R(xname, lreg, rreg, shift, max, invert) \
+	SOC_SINGLE(xname, lreg, shift, max, invert)
+#define SOC_DOUBLE_R_TLV(xname, lreg, rreg, shift, max, invert, tlv) \
+	SOC_SINGLE(xname, lreg, shift, max, invert)
+#define SOC_SINGLE_EXT(xname, reg, shift, max, invert, xget, xput) \
+	{ .name = xname, .get = xget, .put = xput, \
+	  .private_value = SOC_MIXER_PRIV(reg, shift, max, invert) }
+#define SOC_SINGLE_BOOL_EXT(xname, xdata, xget, xput) \
+	{ .name = xname, .get = xget, .put = xput, .private_value = xdata }
+#define SOC_ENUM_SINGLE(xreg, xshift, xitems, xtexts) \
+	{ .reg = xreg, .shift_l = xshift, .items = xitems, \
+	  .texts = (const char * const *)xtexts }
+#define SOC_ENUM(xname, xenum) \
+	{ .name = xname, .private_value = (unsigned long)&xenum }
+#define SOC_DAPM_SINGLE(xname, reg, shift, max, invert) \
+	SOC_SINGLE(xname, reg, shift, max, invert)
+#define DECLARE_TLV_DB_SCALE(name, min, step, mute) \
+	unsigned int name[4] __maybe_unused
+#define SNDRV_CTL_TLVD_DECLARE_DB_RANGE(name, ...) \
+	const unsigned int name[16] __maybe_unused
+#define TLV_DB_SCALE_ITEM(min, step, mute) 0
+#define SND_SOC_NOPM	-1
+
+/* DAPM */
+struct snd_soc_dapm_context {
+	int unused;
+};
+
+struct snd_soc_dapm_widget {
+	const char *name;
+	struct list_head list;
+	struct snd_soc_dapm_context *dapm;
+	int power;
+};
+
+struct snd_soc_dapm_route {
+	const char *sink, *control, *source;
+};
+
+#define SND_SOC_DAPM_INPUT(wname)		{ .name = wname }
+#define SND_SOC_DAPM_OUTPUT(wname)		{ .name = wname }
+#define SND_SOC_DAPM_SUPPLY(wname, ...)		{ .name = wname }
+#define SND_SOC_DAPM_MIXER(wname, ...)		{ .name = wname }
+#define SND_SOC_DAPM_ADC(wname, ...)		{ .name = wname }
+#define SND_SOC_DAPM_DAC(wname, ...)		{ .name = wname }
+#define SND_SOC_DAPM_PGA(wname, ...)		{ .name = wname }
+
+static inline int snd_soc_dapm_new_controls(struct snd_soc_dapm_context *dapm,
+		const struct snd_soc_dapm_widget *widget, int num)
+{
+	return 0;
+}
+
+static inline int snd_soc_dapm_add_routes(struct snd_soc_dapm_context *dapm,
+		const struct snd_soc_dapm_route *route, int num)
+{
+	return 0;
+}
+
+/* Components and DAIs */
+enum snd_soc_bias_level {
+	SND_SOC_BIAS_OFF,
+	SND_SOC_BIAS_STANDBY,
+	SND_SOC_BIAS_PREPARE,
+	SND_SOC_BIAS_ON,
+};
+
+#define SND_SOC_DAIFMT_I2S		1
+#define SND_SOC_DAIFMT_RIGHT_J		2
+#define SND_SOC_DAIFMT_LEFT_J		3
+#define SND_SOC_DAIFMT_DSP_A		4
+#define SND_SOC_DAIFMT_DSP_B		5
+#define SND_SOC_DAIFMT_FORMAT_MASK	0x000f
+#define SND_SOC_DAIFMT_NB_NF		(1 << 8)
+#define SND_SOC_DAIFMT_NB_IF		(2 << 8)
+#define SND_SOC_DAIFMT_IB_NF		(3 << 8)
+#define SND_SOC_DAIFMT_IB_IF		(4 << 8)
+#define SND_SOC_DAIFMT_INV_MASK		0x0f00
+#define SND_SOC_DAIFMT_CBM_CFM		(1 << 12)
+#define SND_SOC_DAIFMT_CBS_CFS		(4 << 12)
+#define SND_SOC_DAIFMT_MASTER_MASK	0xf000
+
+struct snd_soc_card {
+	struct list_head widgets;
+};
+
+struct snd_soc_component_driver {
+	int (*probe)(struct snd_soc_component *component);
+	int (*suspend)(struct snd_soc_component *component);
+	int (*resume)(struct snd_soc_component *component);
+	int (*set_bias_level)(struct snd_soc_component *component,
+			      enum snd_soc_bias_level level);
+	unsigned int suspend_bias_off:1;
+	unsigned int idle_bias_on:1;
+	unsigned int use_pmdown_time:1;
+	unsigned int endianness:1;
+};
+
+struct snd_soc_component {
+	struct device *dev;
+	struct snd_soc_card *card;
+	struct dentry *debugfs_root;
+	struct regmap *regmap;
+	struct snd_soc_dapm_context dapm;
+	enum snd_soc_bias_level bias_level;
+	const struct snd_soc_component_driver *driver;
+	struct snd_soc_dai *dai;
+};
+
+struct snd_soc_dai;
+
+struct snd_soc_dai_ops {
+	int (*startup)(struct snd_pcm_substream *substream,
+		       struct snd_soc_dai *dai);
+	int (*hw_params)(struct snd_pcm_substream *substream,
+			 struct snd_pcm_hw_params *params,
+			 struct snd_soc_dai *dai);
+	int (*hw_free)(struct snd_pcm_substream *substream,
+		       struct snd_soc_dai *dai);
+	snd_pcm_sframes_t (*delay)(struct snd_pcm_substream *substream,
+				   struct snd_soc_dai *dai);
+	int (*mute_stream)(struct snd_soc_dai *dai, int mute, int stream);
+	int (*set_fmt)(struct snd_soc_dai *dai, unsigned int fmt);
+	int (*set_tdm_slot)(struct snd_soc_dai *dai, unsigned int tx_mask,
+			    unsigned int rx_mask, int slots, int slot_width);
+	int (*set_clkdiv)(struct snd_soc_dai *dai, int div_id, int div);
+	int (*set_pll)(struct snd_soc_dai *dai, int pll_id, int source,
+		       unsigned int freq_in, unsigned int freq_out);
+	int (*set_sysclk)(struct snd_soc_dai *dai, int clk_id,
+			  unsigned int freq, int dir);
+};
+
+struct snd_soc_pcm_stream {
+	const char *stream_name;
+	u64 formats;
+	unsigned int rates;
+	unsigned int rate_min, rate_max;
+	unsigned int channels_min, channels_max;
+};
+
+struct snd_soc_dai_driver {
+	const char *name;
+	struct snd_soc_pcm_stream playback, capture;
+	const struct snd_soc_dai_ops *ops;
+	unsigned int symmetric_rate:1;
+};
+
+struct snd_soc_dai {
+	struct snd_soc_component *component;
+	struct device *dev;
+	struct snd_soc_dai_driver *driver;
+};
+
+int devm_snd_soc_register_component(struct device *dev,
+		const struct snd_soc_component_driver *component_driver,
+		struct snd_soc_dai_driver *dai_drv, int num_dai);
+
+static inline void *snd_soc_component_get_drvdata(struct snd_soc_component *c)
+{
+	return dev_get_drvdata(c->dev);
+}
+
+static inline struct snd_soc_component *
+snd_soc_kcontrol_component(struct snd_kcontrol *kcontrol)
+{
+	return kcontrol->private_data;
+}
+
+static inline struct snd_soc_dapm_context *
+snd_soc_component_get_dapm(struct snd_soc_component *c)
+{
+	return &c->dapm;
+}
+
+static inline enum snd_soc_bias_level
+snd_soc_component_get_bias_level(struct snd_soc_component *c)
+{
+	return c->bias_level;
+}
+
+unsigned int snd_soc_component_read(struct snd_soc_component *c,
+				    unsigned int reg);
+int snd_soc_component_write(struct snd_soc_component *c, unsigned int reg,
+			    unsigned int val);
+int snd_soc_component_update_bits(struct snd_soc_component *c,
+				  unsigned int reg, unsigned int mask,
+				  unsigned int val);
+int snd_soc_add_component_controls(struct snd_soc_component *c,
+				   const struct snd_kcontrol_new *controls,
+				   unsigned int num_controls);
+
+/* Platform data, as in include/sound/wm8960.h */
+struct wm8960_data {
+	bool capless;
+	bool shared_lrclk;
+};
+
+/* Test helpers */
+struct snd_soc_component *shim_probe_component(struct device *dev);
+int shim_set_bias_level(struct snd_soc_component *c,
+			enum snd_soc_bias_level level);
+
+#endif
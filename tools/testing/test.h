@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * Helpers for the host tests. Include after wm8960.c, whose static
+ * functions the tests call directly.
+ */
+
+#ifndef _WM8960_TEST_H
+#define _WM8960_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static int test_failures;
+
+#define CHECK(cond, ...)						\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, "%s:%d: %s: ", __FILE__,	\
+				__LINE__, #cond);			\
+			fprintf(stderr, __VA_ARGS__);			\
+			fputc('\n', stderr);				\
+			test_failures++;				\
+		}							\
+	} while (0)
+
+/* One codec on a bus of its own */
+struct test_codec {
+	struct i2c_adapter adap;
+	struct i2c_client i2c;
+	struct device_node np;
+	struct snd_soc_component *component;
+	struct snd_soc_dai *dai;
+	struct wm8960_priv *wm8960;
+};
+
+static int test_codec_probe(struct test_codec *tc, const char *name,
+			    struct clk *mclk, const struct property *props)
+{
+	int ret;
+
+	memset(tc, 0, sizeof(*tc));
+	pthread_mutex_init(&tc->adap.lock, NULL);
+	tc->np.properties = props;
+	tc->i2c.dev.name = name;
+	tc->i2c.dev.of_node = props ? &tc->np : NULL;
+	tc->i2c.dev.clk = mclk;
+	tc->i2c.adapter = &tc->adap;
+
+	ret = wm8960_i2c_driver.probe(&tc->i2c, NULL);
+	if (ret) {
+		shim_device_release(&tc->i2c.dev);
+		return ret;
+	}
+
+	tc->component = shim_probe_component(&tc->i2c.dev);
+	if (IS_ERR(tc->component)) {
+		shim_device_release(&tc->i2c.dev);
+		return PTR_ERR(tc->component);
+	}
+
+	tc->dai = tc->component->dai;
+	tc->wm8960 = snd_soc_component_get_drvdata(tc->component);
+
+	return 0;
+}
+
+static void test_codec_remove(struct test_codec *tc)
+{
+	shim_set_bias_level(tc->component, SND_SOC_BIAS_OFF);
+	shim_device_release(&tc->i2c.dev);
+}
+
+static void test_params(struct snd_pcm_hw_params *params,
+			snd_pcm_format_t format, unsigned int rate,
+			unsigned int channels)
+{
+	params->format.bits = 1ULL << format;
+	params->rate.min = rate;
+	params->rate.max = rate;
+	params->channels = channels;
+}
+
+/* Set a mixer control the way userspace would */
+static int test_put_control(struct test_codec *tc, const char *name,
+			    long val)
+{
+	struct snd_ctl_elem_value ucontrol = { };
+	struct snd_kcontrol kcontrol = {
+		.private_data = tc->component,
+	};
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(wm8960_snd_controls); i++) {
+		if (strcmp(wm8960_snd_controls[i].name, name))
+			continue;
+		if (!wm8960_snd_controls[i].put)
+			return -EINVAL;
+
+		kcontrol.private_value = wm8960_snd_controls[i].private_value;
+		ucontrol.value.integer.value[0] = val;
+
+		return wm8960_snd_controls[i].put(&kcontrol, &ucontrol);
+	}
+
+	return -ENOENT;
+}
+
+static int test_result(const char *name)
+{
+	if (test_failures) {
+		fprintf(stderr, "%s: %d failures\n", name, test_failures);
+		return 1;
+	}
+
+	printf("%s: ok\n", name);
+
+	return 0;
+}
+
+#endif
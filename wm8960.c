@@ -11,11 +11,18 @@
 #include <linux/moduleparam.h>
 #include <linux/init.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
 #include <linux/pm.h>
 #include <linux/clk.h>
 #include <linux/i2c.h>
 #include <linux/slab.h>
 #include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -32,8 +39,28 @@
 
 #include "wm8960.h"
 
+static unsigned int keep_warm_ms;
+module_param(keep_warm_ms, uint, 0644);
+MODULE_PARM_DESC(keep_warm_ms,
+		 "Default time in ms to keep MCLK, PLL and VMID up after the last stream");
+
+/* R9 - Audio Interface 2 */
+#define WM8960_WL8		0x20
+#define WM8960_DACCOMP_SHIFT	3
+#define WM8960_ADCCOMP_SHIFT	1
+#define WM8960_COMP_ULAW	2
+#define WM8960_COMP_ALAW	3
+
+/* R23 - Additional Control 1 */
+#define WM8960_DMONOMIX		0x10
+#define WM8960_DATSEL_MASK	0x0c
+#define WM8960_DATSEL_LEFT	0x04
+
 /* R25 - Power 1 */
 #define WM8960_VMID_MASK 0x180
+#define WM8960_VMID_50K  0x080
+#define WM8960_VMID_250K 0x100
+#define WM8960_VMID_5K   0x180
 #define WM8960_VREF      0x40
 
 /* R26 - Power 2 */
@@ -52,9 +79,84 @@
 #define WM8960_DISOP     0x40
 #define WM8960_DRES_MASK 0x30
 
+/* Power-up settling times, in ms */
+#define WM8960_VMID_RAMP_MS	100
+#define WM8960_VREF_SETTLE_MS	100
+#define WM8960_PLL_LOCK_MS	250
+#define WM8960_VMID_FAST_MS	20
+#define WM8960_VMID_FAST_MAX_MS	WM8960_VMID_RAMP_MS
+#define WM8960_DISCHARGE_MS	600
+#define WM8960_KEEP_WARM_MAX_MS	60000
+#define WM8960_PLL_HOLD_MS	5000
+
+/* Largest PLL output error accepted for a sample rate */
+#define WM8960_RATE_TOLERANCE_PPM	10
+/* PLL output errors closer than this are considered equal */
+#define WM8960_PLL_ERR_RES_PPB		10
+
+/* Runtime PLL trim range, largest step per write and time between writes */
+#define WM8960_PLL_TRIM_MAX_PPM		1000
+#define WM8960_PLL_TRIM_STEP_PPM	50
+#define WM8960_PLL_TRIM_INTERVAL_MS	10
+/* How far the frame clock can be off, with the trim all the way out */
+#define WM8960_RATE_ERROR_MAX_PPM \
+	(WM8960_RATE_TOLERANCE_PPM + WM8960_PLL_TRIM_MAX_PPM)
+
+/* MCLK rates that can be requested from the clock provider */
+#define WM8960_MCLK_RATES_MAX	8
+
+/* Register writes queued for a single multi-message transfer */
+#define WM8960_BURST_MAX	WM8960_CACHEREGNUM
+
+/* PLL divisors */
+struct _pll_div {
+	u32 pre_div:1;
+	u32 n:4;
+	u32 k:24;
+};
+
+/*
+ * Clock divider solution: indexes into sysclk_divs, dac_divs (for both
+ * the DAC and ADC frame clocks) and bclk_divs, plus the PLL output
+ * frequency and divisors when SYSCLK is derived from the PLL (freq_out
+ * == 0 when it comes from MCLK).
+ */
+struct wm8960_clk_sol {
+	s8 sysclk_idx;
+	s8 dac_idx;
+	s8 adc_idx;
+	s8 bclk_idx;
+	int freq_out;
+	struct _pll_div pll_div;
+	/* frame clock error in parts per billion */
+	s32 err_ppb;
+};
+
+/* Precomputed solutions for one (rate, bclk) key */
+struct wm8960_clk_entry {
+	struct wm8960_clk_sol mclk;
+	struct wm8960_clk_sol pll;
+};
+
+/*
+ * Sample rates and word lengths the clock table is built for. The bit
+ * clock of an entry is always 2 * rate * width, mono streams being
+ * clocked as stereo.
+ */
+static const unsigned int wm8960_clk_table_rates[] = {
+	8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000,
+};
+static const int wm8960_clk_table_widths[] = { 8, 16, 20, 24, 32 };
+
 static bool is_pll_freq_available(unsigned int source, unsigned int target);
+static int pll_factors(unsigned int source, unsigned int target,
+		       struct _pll_div *pll_div);
 static int wm8960_set_pll(struct snd_soc_component *component,
 		unsigned int freq_in, unsigned int freq_out);
+static int wm8960_program_pll(struct snd_soc_component *component,
+		const struct _pll_div *pll_div);
+static void wm8960_finish_pll(struct snd_soc_component *component);
+static int wm8960_trim_pll(struct snd_soc_component *component, int ppm);
 /*
  * wm8960 register cache
  * We can't read the WM8960 register space when we are
@@ -124,26 +226,570 @@ static bool wm8960_volatile(struct device *dev, unsigned int reg)
 	}
 }
 
+static bool wm8960_writeable(struct device *dev, unsigned int reg)
+{
+	/* Holes in the register map */
+	switch (reg) {
+	case 0xc ... 0xe:
+	case 0x1e ... 0x1f:
+	case 0x23 ... 0x24:
+	case 0x32:
+		return false;
+	default:
+		return reg <= WM8960_PLL4;
+	}
+}
+
+static bool wm8960_readable(struct device *dev, unsigned int reg)
+{
+	if (reg == WM8960_RESET)
+		return false;
+
+	return wm8960_writeable(dev, reg);
+}
+
+/*
+ * Codecs given the same wlf,clock-domain id share their MCLK and frame
+ * clocks. Only one of them may drive the frame and bit clocks, and while
+ * any of them is clocked the others have to use the same SYSCLK source
+ * and dividers so that all frame clocks stay in step. Codecs that merely
+ * share a crystal but sit on separate links are left out by not giving
+ * them an id. Domains are protected by wm8960_clk_domain_lock.
+ */
+struct wm8960_clk_domain {
+	struct list_head list;
+	u32 id;
+	struct list_head members;
+	struct wm8960_priv *master;
+	/* clocked members and the configuration they all run with */
+	unsigned int active;
+	int lrclk;
+	int adc_lrclk;
+	int bclk;
+	struct wm8960_clk_sol sol;
+};
+
+static LIST_HEAD(wm8960_clk_domains);
+static DEFINE_MUTEX(wm8960_clk_domain_lock);
+
 struct wm8960_priv {
 	struct clk *mclk;
+	struct wm8960_clk_domain *clk_domain;
+	struct list_head clk_domain_node;
+	u32 clk_domain_id;
+	bool clk_domain_active;
 	struct regmap *regmap;
+	struct i2c_client *i2c;
+	/* write bursts, see wm8960_burst_begin() */
+	struct mutex burst_lock;
+	bool i2c_burst;
+	unsigned int burst_depth;
+	unsigned int burst_len;
+	int burst_err;
+	u8 burst_buf[WM8960_BURST_MAX][2];
+	struct i2c_msg burst_msgs[WM8960_BURST_MAX];
 	int (*set_bias_level)(struct snd_soc_component *,
 			      enum snd_soc_bias_level level);
 	struct snd_soc_dapm_widget *lout1;
 	struct snd_soc_dapm_widget *rout1;
 	struct snd_soc_dapm_widget *out3;
 	bool deemph;
+	bool vmid_fast;
+	unsigned int vmid_fast_ms;
 	int lrclk;
 	int bclk;
+	/* ADC frame clock when it differs from lrclk, else 0 */
+	int adc_lrclk;
+	/* per direction rate and bit clock, indexed like is_stream_in_use */
+	int stream_lrclk[2];
+	int stream_bclk[2];
+	/* filter delay in frames, see wm8960_update_delay() */
+	snd_pcm_sframes_t delay[2];
+	/* SYSCLK frequency the dividers were last set up for */
+	int sysclk_rate;
+	/* frame clock they were set up for and its error from the PLL */
+	int clk_rate;
+	s32 clk_err_ppb;
+	bool clk_pll;
+	/* serialises PLL programming with runtime trimming */
+	struct mutex pll_lock;
+	/* runtime trim of the PLL output and when it may next change */
+	int pll_trim_ppm;
+	ktime_t pll_trim_next;
 	int sysclk;
 	int clk_id;
 	int freq_in;
 	bool is_stream_in_use[2];
+	/* mono handling in use per direction, and the settings it replaced */
+	bool mono[2];
+	unsigned int mono_saved[2];
+	/* a mono DSP mode stream is clocked with a single slot */
+	bool single_slot;
+	/* TDM frame set up by set_tdm_slot, 0 slots when not in use */
+	int tdm_slots;
+	int tdm_width;
 	struct wm8960_data pdata;
+	/* clock solutions for the MCLK and PLL input below */
+	struct wm8960_clk_entry
+		clk_table[ARRAY_SIZE(wm8960_clk_table_rates)]
+			 [ARRAY_SIZE(wm8960_clk_table_widths)];
+	int clk_table_mclk;
+	int clk_table_pll;
+	/* at least one key is reachable from MCLK without the PLL */
+	bool clk_table_direct;
+	/* only advertise PLL keys when MCLK cannot clock any directly */
+	bool prefer_mclk;
+	/* any rate from 8 kHz to 48 kHz rather than the standard ones */
+	bool continuous_rates;
+	/* separate ADC and DAC frame clocks, each at its stream's rate */
+	bool asym_rates;
+	/* MCLK rates to ask the clock provider for, from wlf,mclk-rates */
+	u32 mclk_rates[WM8960_MCLK_RATES_MAX];
+	int num_mclk_rates;
+	/* divisors the PLL is currently locked with */
+	struct _pll_div pll_div;
+	bool pll_locked;
+	/* PLL powered up but SYSCLK not switched over until pll_ready */
+	bool pll_pending;
+	ktime_t pll_ready;
+	/* VMID/VREF discharge after BIAS_OFF, completed by discharge_work */
+	struct delayed_work discharge_work;
+	struct completion discharged;
+	/* clocks and references kept up after the last stream */
+	struct snd_soc_component *component;
+	unsigned int keep_warm_ms;
+	bool clk_warm;
+	struct delayed_work keep_warm_work;
+	/* register writes elided because the cache already matched */
+	u32 writes_saved;
+	/* register sync deferred from resume to the next stream */
+	bool resync;
+	ktime_t resumed;
+	u32 resync_us;
 };
 
 #define wm8960_reset(c)	regmap_write(c, WM8960_RESET, 0)
 
+static int wm8960_join_clk_domain(struct wm8960_priv *wm8960)
+{
+	struct device *dev = &wm8960->i2c->dev;
+	struct wm8960_clk_domain *d;
+	struct wm8960_priv *other;
+	int ret = 0;
+
+	if (!wm8960->clk_domain_id)
+		return 0;
+
+	if (IS_ERR(wm8960->mclk)) {
+		dev_err(dev, "A clock domain needs MCLK\n");
+		return -EINVAL;
+	}
+
+	mutex_lock(&wm8960_clk_domain_lock);
+
+	list_for_each_entry(d, &wm8960_clk_domains, list)
+		if (d->id == wm8960->clk_domain_id)
+			goto found;
+
+	d = kzalloc(sizeof(*d), GFP_KERNEL);
+	if (!d) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	d->id = wm8960->clk_domain_id;
+	INIT_LIST_HEAD(&d->members);
+	list_add(&d->list, &wm8960_clk_domains);
+
+found:
+	/* Members leave before their MCLK is put, so this one is valid */
+	if (!list_empty(&d->members)) {
+		other = list_first_entry(&d->members, struct wm8960_priv,
+					 clk_domain_node);
+		if (!clk_is_match(other->mclk, wm8960->mclk)) {
+			dev_err(dev, "Clock domain %u members use another MCLK\n",
+				d->id);
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	list_add_tail(&wm8960->clk_domain_node, &d->members);
+	wm8960->clk_domain = d;
+out:
+	mutex_unlock(&wm8960_clk_domain_lock);
+
+	return ret;
+}
+
+static void wm8960_leave_clk_domain(void *data)
+{
+	struct wm8960_priv *wm8960 = data;
+	struct wm8960_clk_domain *d = wm8960->clk_domain;
+
+	mutex_lock(&wm8960_clk_domain_lock);
+
+	if (d->master == wm8960)
+		d->master = NULL;
+	if (wm8960->clk_domain_active)
+		d->active--;
+	list_del(&wm8960->clk_domain_node);
+	if (list_empty(&d->members)) {
+		list_del(&d->list);
+		kfree(d);
+	}
+	wm8960->clk_domain = NULL;
+
+	mutex_unlock(&wm8960_clk_domain_lock);
+}
+
+/* Claim or give up driving LRCLK and BCLK within the clock domain */
+static int wm8960_domain_set_master(struct wm8960_priv *wm8960, bool master)
+{
+	struct wm8960_clk_domain *d = wm8960->clk_domain;
+	int ret = 0;
+
+	if (!d)
+		return 0;
+
+	mutex_lock(&wm8960_clk_domain_lock);
+
+	if (!master) {
+		if (d->master == wm8960)
+			d->master = NULL;
+	} else if (d->master && d->master != wm8960) {
+		dev_err(&wm8960->i2c->dev,
+			"%s already drives the clocks of this MCLK\n",
+			dev_name(&d->master->i2c->dev));
+		ret = -EBUSY;
+	} else {
+		d->master = wm8960;
+	}
+
+	mutex_unlock(&wm8960_clk_domain_lock);
+
+	return ret;
+}
+
+/* Whether the other clocked members of the domain set the dividers */
+static bool wm8960_domain_busy(struct wm8960_priv *wm8960)
+{
+	return wm8960->clk_domain->active > wm8960->clk_domain_active;
+}
+
+/*
+ * Take the dividers the other clocked codecs of the domain run with.
+ * Returns 1 with *sol filled in, 0 when this codec is free to pick its
+ * own, or an error when it cannot follow them.
+ */
+static int wm8960_domain_get_sol(struct wm8960_priv *wm8960,
+				 struct wm8960_clk_sol *sol)
+{
+	struct wm8960_clk_domain *d = wm8960->clk_domain;
+	bool pll;
+	int ret = 0;
+
+	if (!d)
+		return 0;
+
+	mutex_lock(&wm8960_clk_domain_lock);
+
+	if (wm8960_domain_busy(wm8960)) {
+		pll = d->sol.freq_out != 0;
+		if (d->lrclk != wm8960->lrclk ||
+		    d->adc_lrclk != wm8960->adc_lrclk ||
+		    d->bclk != wm8960->bclk ||
+		    wm8960->clk_id == (pll ? WM8960_SYSCLK_MCLK :
+					     WM8960_SYSCLK_PLL)) {
+			dev_err(&wm8960->i2c->dev,
+				"MCLK is shared with a codec running %d Hz from %s\n",
+				d->lrclk, pll ? "the PLL" : "MCLK");
+			ret = -EBUSY;
+		} else {
+			*sol = d->sol;
+			ret = 1;
+		}
+	}
+
+	mutex_unlock(&wm8960_clk_domain_lock);
+
+	return ret;
+}
+
+/* Record the dividers this codec is about to run with */
+static int wm8960_domain_claim(struct wm8960_priv *wm8960,
+			       const struct wm8960_clk_sol *sol)
+{
+	struct wm8960_clk_domain *d = wm8960->clk_domain;
+	int ret = 0;
+
+	if (!d)
+		return 0;
+
+	mutex_lock(&wm8960_clk_domain_lock);
+
+	if (wm8960_domain_busy(wm8960) &&
+	    (d->sol.sysclk_idx != sol->sysclk_idx ||
+	     d->sol.dac_idx != sol->dac_idx ||
+	     d->sol.adc_idx != sol->adc_idx ||
+	     d->sol.bclk_idx != sol->bclk_idx ||
+	     d->sol.freq_out != sol->freq_out)) {
+		dev_err(&wm8960->i2c->dev,
+			"Clock configuration conflicts with a codec sharing MCLK\n");
+		ret = -EBUSY;
+		goto out;
+	}
+
+	d->sol = *sol;
+	d->lrclk = wm8960->lrclk;
+	d->adc_lrclk = wm8960->adc_lrclk;
+	d->bclk = wm8960->bclk;
+	if (!wm8960->clk_domain_active) {
+		wm8960->clk_domain_active = true;
+		d->active++;
+	}
+out:
+	mutex_unlock(&wm8960_clk_domain_lock);
+
+	return ret;
+}
+
+static void wm8960_domain_release(struct wm8960_priv *wm8960)
+{
+	if (!wm8960->clk_domain)
+		return;
+
+	mutex_lock(&wm8960_clk_domain_lock);
+	if (wm8960->clk_domain_active) {
+		wm8960->clk_domain_active = false;
+		wm8960->clk_domain->active--;
+	}
+	mutex_unlock(&wm8960_clk_domain_lock);
+}
+
+/*
+ * Control interface
+ *
+ * Each register write is a 2 byte I2C message holding the 7 bit address
+ * and 9 bit value. Between wm8960_burst_begin() and wm8960_burst_end()
+ * writes are queued and then sent as one i2c_transfer() of several
+ * messages, saving the bus arbitration and stop/start overhead of one
+ * transfer per register. Adapters that cannot combine messages get them
+ * one at a time.
+ *
+ * Queued writes are already in the register cache, so when a burst fails
+ * the whole cache is marked dirty for the next sync to put right.
+ */
+static int wm8960_i2c_write(struct wm8960_priv *wm8960, const u8 *buf)
+{
+	struct i2c_client *i2c = wm8960->i2c;
+	int ret;
+
+	if (!i2c_check_functionality(i2c->adapter, I2C_FUNC_I2C))
+		return i2c_smbus_write_byte_data(i2c, buf[0], buf[1]);
+
+	ret = i2c_master_send(i2c, buf, 2);
+	if (ret == 2)
+		return 0;
+
+	return ret < 0 ? ret : -EIO;
+}
+
+static int __wm8960_burst_flush(struct wm8960_priv *wm8960)
+{
+	struct i2c_client *i2c = wm8960->i2c;
+	unsigned int i, len = wm8960->burst_len;
+	int ret;
+
+	if (!len)
+		return 0;
+
+	wm8960->burst_len = 0;
+
+	if (wm8960->i2c_burst && len > 1) {
+		for (i = 0; i < len; i++) {
+			wm8960->burst_msgs[i].addr = i2c->addr;
+			wm8960->burst_msgs[i].flags = 0;
+			wm8960->burst_msgs[i].len = 2;
+			wm8960->burst_msgs[i].buf = wm8960->burst_buf[i];
+		}
+
+		ret = i2c_transfer(i2c->adapter, wm8960->burst_msgs, len);
+		if (ret == len)
+			return 0;
+		if (ret != -EOPNOTSUPP)
+			return ret < 0 ? ret : -EIO;
+
+		dev_warn(&i2c->dev,
+			 "Adapter cannot combine messages, not batching writes\n");
+		wm8960->i2c_burst = false;
+	}
+
+	for (i = 0; i < len; i++) {
+		ret = wm8960_i2c_write(wm8960, wm8960->burst_buf[i]);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Send the queued writes, remembering the first failure of the burst */
+static void wm8960_burst_flush(struct wm8960_priv *wm8960)
+{
+	int ret = __wm8960_burst_flush(wm8960);
+
+	if (ret && !wm8960->burst_err)
+		wm8960->burst_err = ret;
+}
+
+static int wm8960_bus_reg_write(void *context, unsigned int reg,
+				unsigned int val)
+{
+	struct wm8960_priv *wm8960 = context;
+	u8 buf[2];
+	int ret = 0;
+
+	buf[0] = (reg << 1) | ((val >> 8) & 0x1);
+	buf[1] = val & 0xff;
+
+	mutex_lock(&wm8960->burst_lock);
+
+	if (!wm8960->burst_depth) {
+		ret = wm8960_i2c_write(wm8960, buf);
+	} else {
+		/* failures are reported by wm8960_burst_end() */
+		if (wm8960->burst_len == WM8960_BURST_MAX)
+			wm8960_burst_flush(wm8960);
+		memcpy(wm8960->burst_buf[wm8960->burst_len++], buf, 2);
+	}
+
+	mutex_unlock(&wm8960->burst_lock);
+
+	return ret;
+}
+
+static int wm8960_bus_reg_read(void *context, unsigned int reg,
+			       unsigned int *val)
+{
+	/* The 2 wire control interface is write only */
+	return -EOPNOTSUPP;
+}
+
+static const struct regmap_bus wm8960_i2c_bus = {
+	.reg_write = wm8960_bus_reg_write,
+	.reg_read = wm8960_bus_reg_read,
+};
+
+static void wm8960_burst_begin(struct wm8960_priv *wm8960)
+{
+	mutex_lock(&wm8960->burst_lock);
+	wm8960->burst_depth++;
+	mutex_unlock(&wm8960->burst_lock);
+}
+
+static int wm8960_burst_end(struct wm8960_priv *wm8960)
+{
+	int ret = 0;
+
+	mutex_lock(&wm8960->burst_lock);
+	if (!--wm8960->burst_depth) {
+		wm8960_burst_flush(wm8960);
+		ret = wm8960->burst_err;
+		wm8960->burst_err = 0;
+	}
+	mutex_unlock(&wm8960->burst_lock);
+
+	if (ret) {
+		dev_err(&wm8960->i2c->dev, "Failed to write registers: %d\n",
+			ret);
+		/* Not under the regmap lock here, unlike in the bus write */
+		regcache_mark_dirty(wm8960->regmap);
+	}
+
+	return ret;
+}
+
+static int wm8960_sync(struct wm8960_priv *wm8960)
+{
+	int ret, err;
+
+	wm8960_burst_begin(wm8960);
+	ret = regcache_sync(wm8960->regmap);
+	err = wm8960_burst_end(wm8960);
+
+	return ret ? ret : err;
+}
+
+/*
+ * Update a register under the regmap lock, which skips the bus
+ * transaction altogether when the cached value would not change, and
+ * count the writes saved that way.
+ */
+static int wm8960_update_reg(struct snd_soc_component *component,
+			     unsigned int reg, unsigned int mask,
+			     unsigned int val)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	int ret;
+
+	ret = snd_soc_component_update_bits(component, reg, mask, val);
+	if (ret < 0)
+		return ret;
+	if (!ret)
+		wm8960->writes_saved++;
+
+	return 0;
+}
+
+#define wm8960_write_reg(c, r, v)	wm8960_update_reg(c, r, 0x1ff, v)
+
+/*
+ * Power-up steps are started back to back and each records the time
+ * it has settled by, so that the sequence only waits for the longest
+ * one rather than for the sum of them.
+ */
+static void wm8960_wait_until(ktime_t deadline)
+{
+	s64 remaining = ktime_ms_delta(deadline, ktime_get());
+
+	if (remaining > 0)
+		msleep(remaining);
+}
+
+static void wm8960_discharge_work(struct work_struct *work)
+{
+	struct wm8960_priv *wm8960 = container_of(to_delayed_work(work),
+						  struct wm8960_priv,
+						  discharge_work);
+
+	complete_all(&wm8960->discharged);
+}
+
+/*
+ * Bring VMID up from off and leave it at 2x50k. In fast start mode the
+ * reference capacitor is charged through the 2x5k string for a short
+ * time instead of the full 2x50k ramp.
+ */
+static void wm8960_ramp_vmid(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	if (!wm8960->vmid_fast) {
+		snd_soc_component_update_bits(component, WM8960_POWER1,
+					      WM8960_VMID_MASK, WM8960_VMID_50K);
+		wm8960_wait_until(ktime_add_ms(ktime_get(),
+					       WM8960_VMID_RAMP_MS));
+		return;
+	}
+
+	snd_soc_component_update_bits(component, WM8960_POWER1,
+				      WM8960_VMID_MASK, WM8960_VMID_5K);
+	wm8960_wait_until(ktime_add_ms(ktime_get(), wm8960->vmid_fast_ms));
+
+	snd_soc_component_update_bits(component, WM8960_POWER1,
+				      WM8960_VMID_MASK, WM8960_VMID_50K);
+}
+
 /* enumerated controls */
 static const char *wm8960_polarity[] = {"No Inversion", "Left Inverted",
 	"Right Inverted", "Stereo Inversion"};
@@ -183,8 +829,8 @@ static int wm8960_set_deemph(struct snd_soc_component *component)
 	if (wm8960->deemph) {
 		best = 1;
 		for (i = 2; i < ARRAY_SIZE(deemph_settings); i++) {
-			if (abs(deemph_settings[i] - wm8960->lrclk) <
-			    abs(deemph_settings[best] - wm8960->lrclk))
+			if (abs(deemph_settings[i] - wm8960->stream_lrclk[1]) <
+			    abs(deemph_settings[best] - wm8960->stream_lrclk[1]))
 				best = i;
 		}
 
@@ -195,8 +841,50 @@ static int wm8960_set_deemph(struct snd_soc_component *component)
 
 	dev_dbg(component->dev, "Set deemphasis %d\n", val);
 
-	return snd_soc_component_update_bits(component, WM8960_DACCTL1,
-				   0x6, val);
+	return wm8960_update_reg(component, WM8960_DACCTL1, 0x6, val);
+}
+
+/*
+ * Group delay of the digital filters in tenths of a frame, from the
+ * digital filter characteristics in the datasheet. The filters run at
+ * the stream's sample rate, so the delay in frames does not depend on
+ * it. The datasheet gives no delay for the ADC high-pass filter.
+ */
+#define WM8960_ADC_DELAY		230
+#define WM8960_DAC_DELAY		110
+#define WM8960_DAC_SLOPE_DELAY		46
+
+/*
+ * Work out the delay .delay reports whenever the filters change or a
+ * stream is set up or freed. Directions not in use report none.
+ */
+static void wm8960_update_delay(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	unsigned int delay;
+
+	if (snd_soc_component_read(component, WM8960_DACCTL2) & 0x2)
+		delay = WM8960_DAC_SLOPE_DELAY;
+	else
+		delay = WM8960_DAC_DELAY;
+
+	WRITE_ONCE(wm8960->delay[1], wm8960->is_stream_in_use[1] ?
+		   DIV_ROUND_CLOSEST(delay, 10) : 0);
+	WRITE_ONCE(wm8960->delay[0], wm8960->is_stream_in_use[0] ?
+		   DIV_ROUND_CLOSEST(WM8960_ADC_DELAY, 10) : 0);
+}
+
+static int wm8960_put_dac_slope(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	int ret;
+
+	ret = snd_soc_put_volsw(kcontrol, ucontrol);
+	if (ret >= 0)
+		wm8960_update_delay(component);
+
+	return ret;
 }
 
 static int wm8960_get_deemph(struct snd_kcontrol *kcontrol,
@@ -224,33 +912,244 @@ static int wm8960_put_deemph(struct snd_kcontrol *kcontrol,
 	return wm8960_set_deemph(component);
 }
 
-static const DECLARE_TLV_DB_SCALE(adc_tlv, -9750, 50, 1);
-static const DECLARE_TLV_DB_SCALE(inpga_tlv, -1725, 75, 0);
-static const DECLARE_TLV_DB_SCALE(dac_tlv, -12750, 50, 1);
-static const DECLARE_TLV_DB_SCALE(bypass_tlv, -2100, 300, 0);
-static const DECLARE_TLV_DB_SCALE(out_tlv, -12100, 100, 1);
-static const DECLARE_TLV_DB_SCALE(lineinboost_tlv, -1500, 300, 1);
-static const SNDRV_CTL_TLVD_DECLARE_DB_RANGE(micboost_tlv,
-	0, 1, TLV_DB_SCALE_ITEM(0, 1300, 0),
-	2, 3, TLV_DB_SCALE_ITEM(2000, 900, 0),
-);
+static int wm8960_get_vmid_fast(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
 
-static const struct snd_kcontrol_new wm8960_snd_controls[] = {
-SOC_DOUBLE_R_TLV("Capture Volume", WM8960_LINVOL, WM8960_RINVOL,
-		 0, 63, 0, inpga_tlv),
-SOC_DOUBLE_R("Capture Volume ZC Switch", WM8960_LINVOL, WM8960_RINVOL,
-	6, 1, 0),
-SOC_DOUBLE_R("Capture Switch", WM8960_LINVOL, WM8960_RINVOL,
-	7, 1, 1),
+	ucontrol->value.integer.value[0] = wm8960->vmid_fast;
+	return 0;
+}
 
-SOC_SINGLE_TLV("Left Input Boost Mixer LINPUT3 Volume",
-	       WM8960_INBMIX1, 4, 7, 0, lineinboost_tlv),
-SOC_SINGLE_TLV("Left Input Boost Mixer LINPUT2 Volume",
-	       WM8960_INBMIX1, 1, 7, 0, lineinboost_tlv),
-SOC_SINGLE_TLV("Right Input Boost Mixer RINPUT3 Volume",
-	       WM8960_INBMIX2, 4, 7, 0, lineinboost_tlv),
-SOC_SINGLE_TLV("Right Input Boost Mixer RINPUT2 Volume",
-	       WM8960_INBMIX2, 1, 7, 0, lineinboost_tlv),
+static int wm8960_put_vmid_fast(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	unsigned int fast = ucontrol->value.integer.value[0];
+
+	if (fast > 1)
+		return -EINVAL;
+
+	if (wm8960->vmid_fast == fast)
+		return 0;
+
+	wm8960->vmid_fast = fast;
+	return 1;
+}
+
+static int wm8960_info_vmid_fast_ms(struct snd_kcontrol *kcontrol,
+				    struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 1;
+	uinfo->value.integer.max = WM8960_VMID_FAST_MAX_MS;
+	return 0;
+}
+
+static int wm8960_get_vmid_fast_ms(struct snd_kcontrol *kcontrol,
+				   struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = wm8960->vmid_fast_ms;
+	return 0;
+}
+
+static int wm8960_put_vmid_fast_ms(struct snd_kcontrol *kcontrol,
+				   struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	long ms = ucontrol->value.integer.value[0];
+
+	if (ms < 1 || ms > WM8960_VMID_FAST_MAX_MS)
+		return -EINVAL;
+
+	if (wm8960->vmid_fast_ms == ms)
+		return 0;
+
+	wm8960->vmid_fast_ms = ms;
+	return 1;
+}
+
+static int wm8960_get_keep_warm(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = wm8960->keep_warm_ms;
+	return 0;
+}
+
+static int wm8960_put_keep_warm(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	long ms = ucontrol->value.integer.value[0];
+
+	if (ms < 0 || ms > WM8960_KEEP_WARM_MAX_MS)
+		return -EINVAL;
+
+	if (wm8960->keep_warm_ms == ms)
+		return 0;
+
+	/* Takes effect when the next stream goes idle */
+	wm8960->keep_warm_ms = ms;
+	return 1;
+}
+
+/* Frame clock error of the last clock setup, including the PLL trim */
+static s32 wm8960_rate_error(struct wm8960_priv *wm8960)
+{
+	if (!wm8960->clk_pll)
+		return wm8960->clk_err_ppb;
+
+	return wm8960->clk_err_ppb + wm8960->pll_trim_ppm * 1000;
+}
+
+/* Frame clock the dividers were last set up for, corrected by its error */
+static int wm8960_effective_rate(struct wm8960_priv *wm8960)
+{
+	return wm8960->clk_rate +
+	       div_s64((s64)wm8960->clk_rate * wm8960_rate_error(wm8960),
+		       1000000000);
+}
+
+static int wm8960_info_effective_rate(struct snd_kcontrol *kcontrol,
+				      struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = 48000 +
+		DIV_ROUND_UP(48000 * WM8960_RATE_ERROR_MAX_PPM, 1000000);
+	return 0;
+}
+
+static int wm8960_get_effective_rate(struct snd_kcontrol *kcontrol,
+				     struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = wm8960_effective_rate(wm8960);
+	return 0;
+}
+
+static int wm8960_info_rate_error(struct snd_kcontrol *kcontrol,
+				  struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = -WM8960_RATE_ERROR_MAX_PPM * 1000;
+	uinfo->value.integer.max = WM8960_RATE_ERROR_MAX_PPM * 1000;
+	return 0;
+}
+
+static int wm8960_get_rate_error(struct snd_kcontrol *kcontrol,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = wm8960_rate_error(wm8960);
+	return 0;
+}
+
+static int wm8960_info_pll_trim(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = -WM8960_PLL_TRIM_MAX_PPM;
+	uinfo->value.integer.max = WM8960_PLL_TRIM_MAX_PPM;
+	return 0;
+}
+
+static int wm8960_get_pll_trim(struct snd_kcontrol *kcontrol,
+			       struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	ucontrol->value.integer.value[0] = wm8960->pll_trim_ppm;
+	return 0;
+}
+
+/*
+ * Each write moves the PLL by at most WM8960_PLL_TRIM_STEP_PPM, and
+ * writes closer than WM8960_PLL_TRIM_INTERVAL_MS apart are refused, so
+ * that a misbehaving tracking loop cannot swing the sample rate.
+ */
+static int wm8960_put_pll_trim(struct snd_kcontrol *kcontrol,
+			       struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component = snd_soc_kcontrol_component(kcontrol);
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	long ppm = ucontrol->value.integer.value[0];
+	ktime_t now = ktime_get();
+	int ret;
+
+	if (ppm < -WM8960_PLL_TRIM_MAX_PPM || ppm > WM8960_PLL_TRIM_MAX_PPM)
+		return -EINVAL;
+
+	if (ppm == wm8960->pll_trim_ppm)
+		return 0;
+
+	if (ktime_before(now, wm8960->pll_trim_next))
+		return -EBUSY;
+
+	ppm = clamp_t(long, ppm,
+		      wm8960->pll_trim_ppm - WM8960_PLL_TRIM_STEP_PPM,
+		      wm8960->pll_trim_ppm + WM8960_PLL_TRIM_STEP_PPM);
+
+	ret = wm8960_trim_pll(component, ppm);
+	if (ret)
+		return ret;
+
+	wm8960->pll_trim_next = ktime_add_ms(now, WM8960_PLL_TRIM_INTERVAL_MS);
+	return 1;
+}
+
+#define WM8960_READBACK(xname, xinfo, xget) \
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
+	.access = SNDRV_CTL_ELEM_ACCESS_READ | \
+		  SNDRV_CTL_ELEM_ACCESS_VOLATILE, \
+	.info = xinfo, .get = xget }
+
+static const DECLARE_TLV_DB_SCALE(adc_tlv, -9750, 50, 1);
+static const DECLARE_TLV_DB_SCALE(inpga_tlv, -1725, 75, 0);
+static const DECLARE_TLV_DB_SCALE(dac_tlv, -12750, 50, 1);
+static const DECLARE_TLV_DB_SCALE(bypass_tlv, -2100, 300, 0);
+static const DECLARE_TLV_DB_SCALE(out_tlv, -12100, 100, 1);
+static const DECLARE_TLV_DB_SCALE(lineinboost_tlv, -1500, 300, 1);
+static const SNDRV_CTL_TLVD_DECLARE_DB_RANGE(micboost_tlv,
+	0, 1, TLV_DB_SCALE_ITEM(0, 1300, 0),
+	2, 3, TLV_DB_SCALE_ITEM(2000, 900, 0),
+);
+
+static const struct snd_kcontrol_new wm8960_snd_controls[] = {
+SOC_DOUBLE_R_TLV("Capture Volume", WM8960_LINVOL, WM8960_RINVOL,
+		 0, 63, 0, inpga_tlv),
+SOC_DOUBLE_R("Capture Volume ZC Switch", WM8960_LINVOL, WM8960_RINVOL,
+	6, 1, 0),
+SOC_DOUBLE_R("Capture Switch", WM8960_LINVOL, WM8960_RINVOL,
+	7, 1, 1),
+
+SOC_SINGLE_TLV("Left Input Boost Mixer LINPUT3 Volume",
+	       WM8960_INBMIX1, 4, 7, 0, lineinboost_tlv),
+SOC_SINGLE_TLV("Left Input Boost Mixer LINPUT2 Volume",
+	       WM8960_INBMIX1, 1, 7, 0, lineinboost_tlv),
+SOC_SINGLE_TLV("Right Input Boost Mixer RINPUT3 Volume",
+	       WM8960_INBMIX2, 4, 7, 0, lineinboost_tlv),
+SOC_SINGLE_TLV("Right Input Boost Mixer RINPUT2 Volume",
+	       WM8960_INBMIX2, 1, 7, 0, lineinboost_tlv),
 SOC_SINGLE_TLV("Right Input Boost Mixer RINPUT1 Volume",
 		WM8960_RINPATH, 4, 3, 0, micboost_tlv),
 SOC_SINGLE_TLV("Left Input Boost Mixer LINPUT1 Volume",
@@ -276,6 +1175,10 @@ SOC_ENUM("ADC Polarity", wm8960_enum[0]),
 SOC_SINGLE("ADC High Pass Filter Switch", WM8960_DACCTL1, 0, 1, 0),
 
 SOC_ENUM("DAC Polarity", wm8960_enum[1]),
+SOC_SINGLE_EXT("DAC Sloping Stopband Filter Switch", WM8960_DACCTL2, 1, 1, 0,
+	       snd_soc_get_volsw, wm8960_put_dac_slope),
+/* feeds ADC data straight into the DAC, for latency measurements */
+SOC_SINGLE("Digital Loopback Switch", WM8960_IFACE2, 0, 1, 0),
 SOC_SINGLE_BOOL_EXT("DAC Deemphasis Switch", 0,
 		    wm8960_get_deemph, wm8960_put_deemph),
 
@@ -310,6 +1213,22 @@ SOC_SINGLE_TLV("Right Output Mixer RINPUT3 Volume",
 
 SOC_ENUM("ADC Data Output Select", wm8960_enum[6]),
 SOC_ENUM("DAC Mono Mix", wm8960_enum[7]),
+
+SOC_SINGLE_BOOL_EXT("VMID Fast Start Switch", 0,
+		    wm8960_get_vmid_fast, wm8960_put_vmid_fast),
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "VMID Fast Start Time",
+	.info = wm8960_info_vmid_fast_ms,
+	.get = wm8960_get_vmid_fast_ms, .put = wm8960_put_vmid_fast_ms },
+SOC_SINGLE_EXT("Keep Warm Time", SND_SOC_NOPM, 0,
+	       WM8960_KEEP_WARM_MAX_MS, 0,
+	       wm8960_get_keep_warm, wm8960_put_keep_warm),
+WM8960_READBACK("Effective Sample Rate", wm8960_info_effective_rate,
+		wm8960_get_effective_rate),
+WM8960_READBACK("Sample Rate Error ppb", wm8960_info_rate_error,
+		wm8960_get_rate_error),
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = "PLL Trim ppm",
+	.info = wm8960_info_pll_trim,
+	.get = wm8960_get_pll_trim, .put = wm8960_put_pll_trim },
 };
 
 static const struct snd_kcontrol_new wm8960_lin_boost[] = {
@@ -526,7 +1445,9 @@ static int wm8960_set_dai_fmt(struct snd_soc_dai *codec_dai,
 		unsigned int fmt)
 {
 	struct snd_soc_component *component = codec_dai->component;
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
 	u16 iface = 0;
+	int ret;
 
 	/* set master/slave audio interface */
 	switch (fmt & SND_SOC_DAIFMT_MASTER_MASK) {
@@ -576,8 +1497,50 @@ static int wm8960_set_dai_fmt(struct snd_soc_dai *codec_dai,
 		return -EINVAL;
 	}
 
+	ret = wm8960_domain_set_master(wm8960, iface & 0x0040);
+	if (ret)
+		return ret;
+
 	/* set iface */
-	snd_soc_component_write(component, WM8960_IFACE1, iface);
+	wm8960_write_reg(component, WM8960_IFACE1, iface);
+	return 0;
+}
+
+/*
+ * The WM8960 has no slot offset: in DSP mode its left and right words
+ * always occupy the first slots after the frame sync. TDM setup can only
+ * make the frame longer, so that other devices use the later slots.
+ */
+static int wm8960_set_dai_tdm_slot(struct snd_soc_dai *dai,
+				   unsigned int tx_mask, unsigned int rx_mask,
+				   int slots, int slot_width)
+{
+	struct snd_soc_component *component = dai->component;
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	if (!slots) {
+		wm8960->tdm_slots = 0;
+		return 0;
+	}
+
+	/* slot 0 for mono, slots 0 and 1 for stereo */
+	if ((tx_mask & ~0x3) || tx_mask == 0x2 ||
+	    (rx_mask & ~0x3) || rx_mask == 0x2) {
+		dev_err(component->dev,
+			"only slots 0 and 1 are supported, tx %x rx %x\n",
+			tx_mask, rx_mask);
+		return -EINVAL;
+	}
+
+	if (slots < 2 || slot_width < 8 || slot_width > 32) {
+		dev_err(component->dev, "unsupported TDM frame %d x %d bits\n",
+			slots, slot_width);
+		return -EINVAL;
+	}
+
+	wm8960->tdm_slots = slots;
+	wm8960->tdm_width = slot_width;
+
 	return 0;
 }
 
@@ -608,6 +1571,25 @@ static const int bclk_divs[] = {
 	120, 160, 220, 240, 320, 320, 320
 };
 
+/*
+ * ADC divider index giving adc_lrclk from the sysclk that the DAC divider
+ * dac_idx derives lrclk from, or -1. An adc_lrclk of 0 means the ADC runs
+ * at the DAC rate.
+ */
+static int wm8960_adc_div(int sysclk, int lrclk, int adc_lrclk, int dac_idx)
+{
+	int a;
+
+	if (!adc_lrclk || adc_lrclk == lrclk)
+		return dac_idx;
+
+	for (a = 0; a < ARRAY_SIZE(dac_divs); a++)
+		if (adc_lrclk * dac_divs[a] == sysclk)
+			return a;
+
+	return -1;
+}
+
 /**
  * wm8960_configure_sysclk - checks if there is a sysclk frequency available
  *	The sysclk must be chosen such that:
@@ -619,30 +1601,30 @@ static const int bclk_divs[] = {
  *	triplet, we relax the bclk such that bclk is chosen as the
  *	closest available frequency greater than expected bclk.
  *
- * @wm8960_priv: wm8960 codec private data
  * @mclk: MCLK used to derive sysclk
- * @sysclk_idx: sysclk_divs index for found sysclk
- * @dac_idx: dac_divs index for found lrclk
- * @bclk_idx: bclk_divs index for found bclk
+ * @lrclk: expected frame clock
+ * @adc_lrclk: expected ADC frame clock, 0 when the same as @lrclk
+ * @bclk: expected bit clock
+ * @sol: dividers found for (sysclk, lrclk, bclk)
  *
  * Returns:
  *  -1, in case no sysclk frequency available found
  * >=0, in case we could derive bclk and lrclk from sysclk using
- *      (@sysclk_idx, @dac_idx, @bclk_idx) dividers
+ *      @sol dividers
  */
 static
-int wm8960_configure_sysclk(struct wm8960_priv *wm8960, int mclk,
-			    int *sysclk_idx, int *dac_idx, int *bclk_idx)
+int wm8960_configure_sysclk(int mclk, int lrclk, int adc_lrclk, int bclk,
+			    struct wm8960_clk_sol *sol)
 {
-	int sysclk, bclk, lrclk;
-	int i, j, k;
-	int diff, closest = mclk;
+	int sysclk;
+	int i, j, k, a;
+	int closest = mclk;
+	s64 diff;
 
 	/* marker for no match */
-	*bclk_idx = -1;
-
-	bclk = wm8960->bclk;
-	lrclk = wm8960->lrclk;
+	sol->sysclk_idx = sol->dac_idx = sol->adc_idx = sol->bclk_idx = -1;
+	sol->freq_out = 0;
+	sol->err_ppb = 0;
 
 	/* check if the sysclk frequency is available. */
 	for (i = 0; i < ARRAY_SIZE(sysclk_divs); ++i) {
@@ -652,18 +1634,23 @@ int wm8960_configure_sysclk(struct wm8960_priv *wm8960, int mclk,
 		for (j = 0; j < ARRAY_SIZE(dac_divs); ++j) {
 			if (sysclk != dac_divs[j] * lrclk)
 				continue;
+			a = wm8960_adc_div(sysclk, lrclk, adc_lrclk, j);
+			if (a < 0)
+				continue;
 			for (k = 0; k < ARRAY_SIZE(bclk_divs); ++k) {
-				diff = sysclk - bclk * bclk_divs[k] / 10;
+				diff = sysclk - (s64)bclk * bclk_divs[k] / 10;
 				if (diff == 0) {
-					*sysclk_idx = i;
-					*dac_idx = j;
-					*bclk_idx = k;
+					sol->sysclk_idx = i;
+					sol->dac_idx = j;
+					sol->adc_idx = a;
+					sol->bclk_idx = k;
 					break;
 				}
 				if (diff > 0 && closest > diff) {
-					*sysclk_idx = i;
-					*dac_idx = j;
-					*bclk_idx = k;
+					sol->sysclk_idx = i;
+					sol->dac_idx = j;
+					sol->adc_idx = a;
+					sol->bclk_idx = k;
 					closest = diff;
 				}
 			}
@@ -673,7 +1660,25 @@ int wm8960_configure_sysclk(struct wm8960_priv *wm8960, int mclk,
 		if (j != ARRAY_SIZE(dac_divs))
 			break;
 	}
-	return *bclk_idx;
+	return sol->bclk_idx;
+}
+
+/*
+ * Error of the PLL output the divisors actually give against freq_out,
+ * in parts per billion: K is rounded to 24 bits and MCLK is halved by
+ * the prescaler before the PLL.
+ */
+static s32 wm8960_pll_error(unsigned int freq_in, unsigned int freq_out,
+			    const struct _pll_div *pll_div)
+{
+	s64 rate, want;
+
+	/* both scaled by 4 << 24 */
+	rate = (s64)(freq_in >> pll_div->pre_div) *
+	       (((s64)pll_div->n << 24) + pll_div->k);
+	want = (s64)freq_out << 26;
+
+	return div64_s64((rate - want) * 1000000000, want);
 }
 
 /**
@@ -687,32 +1692,34 @@ int wm8960_configure_sysclk(struct wm8960_priv *wm8960, int mclk,
  * 	triplet, we relax the bclk such that bclk is chosen as the
  * 	closest available frequency greater than expected bclk.
  *
- * @component: component structure
+ *	Among the candidates with the best bclk match, the one whose PLL
+ *	output is closest to the wanted frequency is picked, and none is
+ *	accepted further than WM8960_RATE_TOLERANCE_PPM from it.
+ *
  * @freq_in: input frequency used to derive freq out via PLL
- * @sysclk_idx: sysclk_divs index for found sysclk
- * @dac_idx: dac_divs index for found lrclk
- * @bclk_idx: bclk_divs index for found bclk
+ * @lrclk: expected frame clock
+ * @adc_lrclk: expected ADC frame clock, 0 when the same as @lrclk
+ * @bclk: expected bit clock
+ * @sol: dividers and PLL divisors found for (sysclk, lrclk, bclk)
  *
  * Returns:
  * < 0, in case no PLL frequency out available was found
  * >=0, in case we could derive bclk, lrclk, sysclk from PLL out using
- *      (@sysclk_idx, @dac_idx, @bclk_idx) dividers
+ *      @sol dividers
  */
 static
-int wm8960_configure_pll(struct snd_soc_component *component, int freq_in,
-			 int *sysclk_idx, int *dac_idx, int *bclk_idx)
+int wm8960_configure_pll(int freq_in, int lrclk, int adc_lrclk, int bclk,
+			 struct wm8960_clk_sol *sol)
 {
-	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
-	int sysclk, bclk, lrclk, freq_out;
-	int diff, closest, best_freq_out;
-	int i, j, k;
+	struct _pll_div pll_div;
+	int sysclk, freq_out;
+	int closest, best = 0;
+	s64 diff;
+	s32 err;
+	int i, j, k, a, b;
 
-	bclk = wm8960->bclk;
-	lrclk = wm8960->lrclk;
-	closest = freq_in;
-
-	best_freq_out = -EINVAL;
-	*sysclk_idx = *dac_idx = *bclk_idx = -1;
+	sol->sysclk_idx = sol->dac_idx = sol->adc_idx = sol->bclk_idx = -1;
+	sol->freq_out = -EINVAL;
 
 	for (i = 0; i < ARRAY_SIZE(sysclk_divs); ++i) {
 		if (sysclk_divs[i] == -1)
@@ -721,36 +1728,394 @@ int wm8960_configure_pll(struct snd_soc_component *component, int freq_in,
 			sysclk = lrclk * dac_divs[j];
 			freq_out = sysclk * sysclk_divs[i];
 
-			for (k = 0; k < ARRAY_SIZE(bclk_divs); ++k) {
-				if (!is_pll_freq_available(freq_in, freq_out))
-					continue;
+			if (!is_pll_freq_available(freq_in, freq_out))
+				continue;
 
-				diff = sysclk - bclk * bclk_divs[k] / 10;
-				if (diff == 0) {
-					*sysclk_idx = i;
-					*dac_idx = j;
-					*bclk_idx = k;
-					return freq_out;
-				}
-				if (diff > 0 && closest > diff) {
-					*sysclk_idx = i;
-					*dac_idx = j;
-					*bclk_idx = k;
+			a = wm8960_adc_div(sysclk, lrclk, adc_lrclk, j);
+			if (a < 0)
+				continue;
+
+			if (pll_factors(freq_in, freq_out, &pll_div))
+				continue;
+
+			err = wm8960_pll_error(freq_in, freq_out, &pll_div);
+			if (abs(err) > WM8960_RATE_TOLERANCE_PPM * 1000)
+				continue;
+
+			/* closest bit clock not slower than the expected one */
+			closest = INT_MAX;
+			b = -1;
+			for (k = 0; k < ARRAY_SIZE(bclk_divs); ++k) {
+				diff = sysclk - (s64)bclk * bclk_divs[k] / 10;
+				if (diff >= 0 && diff < closest) {
 					closest = diff;
-					best_freq_out = freq_out;
+					b = k;
 				}
 			}
+			if (b < 0)
+				continue;
+
+			/* differences within the K resolution do not count */
+			if (sol->bclk_idx >= 0 &&
+			    (closest > best ||
+			     (closest == best && abs(err) / WM8960_PLL_ERR_RES_PPB >=
+				abs(sol->err_ppb) / WM8960_PLL_ERR_RES_PPB)))
+				continue;
+
+			sol->sysclk_idx = i;
+			sol->dac_idx = j;
+			sol->adc_idx = a;
+			sol->bclk_idx = b;
+			sol->freq_out = freq_out;
+			sol->pll_div = pll_div;
+			sol->err_ppb = err;
+			best = closest;
+		}
+	}
+
+	return sol->freq_out;
+}
+
+/*
+ * Solve every (rate, width) key once for the given MCLK and PLL input
+ * frequencies, so that stream setup only has to look the dividers up.
+ * A frequency of 0 means the corresponding source is not available.
+ */
+static void wm8960_build_clk_table(struct wm8960_priv *wm8960,
+				   int mclk, int pll_in)
+{
+	struct wm8960_clk_entry *entry;
+	int lrclk, bclk;
+	int r, w;
+
+	if (wm8960->clk_table_mclk == mclk && wm8960->clk_table_pll == pll_in)
+		return;
+
+	wm8960->clk_table_direct = false;
+
+	for (r = 0; r < ARRAY_SIZE(wm8960_clk_table_rates); r++) {
+		lrclk = wm8960_clk_table_rates[r];
+		for (w = 0; w < ARRAY_SIZE(wm8960_clk_table_widths); w++) {
+			bclk = 2 * lrclk * wm8960_clk_table_widths[w];
+			entry = &wm8960->clk_table[r][w];
+
+			entry->mclk.sysclk_idx = entry->mclk.dac_idx = -1;
+			entry->mclk.adc_idx = entry->mclk.bclk_idx = -1;
+			if (mclk &&
+			    wm8960_configure_sysclk(mclk, lrclk, 0, bclk,
+						    &entry->mclk) >= 0)
+				wm8960->clk_table_direct = true;
+
+			entry->pll.sysclk_idx = entry->pll.dac_idx = -1;
+			entry->pll.adc_idx = entry->pll.bclk_idx = -1;
+			if (pll_in)
+				wm8960_configure_pll(pll_in, lrclk, 0, bclk,
+						     &entry->pll);
 		}
 	}
 
-	return best_freq_out;
+	wm8960->clk_table_mclk = mclk;
+	wm8960->clk_table_pll = pll_in;
+}
+
+/* Rebuild the clock table for the current clock source configuration */
+static void wm8960_update_clk_table(struct wm8960_priv *wm8960)
+{
+	int mclk = 0, pll_in = 0;
+
+	if (wm8960->clk_id == WM8960_SYSCLK_AUTO)
+		mclk = wm8960->freq_in;
+	else if (wm8960->clk_id == WM8960_SYSCLK_MCLK)
+		mclk = wm8960->sysclk;
+
+	if (wm8960->clk_id != WM8960_SYSCLK_MCLK)
+		pll_in = wm8960->freq_in;
+
+	wm8960_build_clk_table(wm8960, mclk, pll_in);
+}
+
+/*
+ * Find the dividers for the current lrclk/bclk, either from the clock
+ * table or, for keys the table does not cover, by running the search.
+ */
+static int wm8960_find_clk_sol(struct wm8960_priv *wm8960, int freq,
+			       bool use_pll, struct wm8960_clk_sol *sol)
+{
+	int lrclk = wm8960->lrclk;
+	int adc_lrclk = wm8960->adc_lrclk;
+	int bclk = wm8960->bclk;
+	int r, w;
+
+	for (r = 0; r < ARRAY_SIZE(wm8960_clk_table_rates); r++)
+		if (wm8960_clk_table_rates[r] == lrclk)
+			break;
+
+	for (w = 0; w < ARRAY_SIZE(wm8960_clk_table_widths); w++)
+		if (2 * lrclk * wm8960_clk_table_widths[w] == bclk)
+			break;
+
+	if ((!adc_lrclk || adc_lrclk == lrclk) &&
+	    r < ARRAY_SIZE(wm8960_clk_table_rates) &&
+	    w < ARRAY_SIZE(wm8960_clk_table_widths) &&
+	    freq == (use_pll ? wm8960->clk_table_pll : wm8960->clk_table_mclk))
+		*sol = use_pll ? wm8960->clk_table[r][w].pll :
+				 wm8960->clk_table[r][w].mclk;
+	else if (use_pll)
+		wm8960_configure_pll(freq, lrclk, adc_lrclk, bclk, sol);
+	else
+		wm8960_configure_sysclk(freq, lrclk, adc_lrclk, bclk, sol);
+
+	if (sol->bclk_idx < 0)
+		return -EINVAL;
+
+	/*
+	 * Other devices on a TDM bus count on the slot layout, so when
+	 * driving it the bit clock has to be exact rather than faster.
+	 */
+	if (wm8960->tdm_slots && wm8960->component &&
+	    (snd_soc_component_read(wm8960->component, WM8960_IFACE1) & 0x40) &&
+	    (s64)lrclk * dac_divs[sol->dac_idx] * 10 !=
+	    (s64)bclk * bclk_divs[sol->bclk_idx])
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Whether a (rate, width) key of the clock table should be offered to
+ * userspace: always when MCLK can clock it directly, otherwise only if
+ * the PLL can and rates without the PLL are not preferred.
+ */
+static bool wm8960_clk_allowed(struct wm8960_priv *wm8960, int r, int w)
+{
+	const struct wm8960_clk_entry *entry = &wm8960->clk_table[r][w];
+
+	if (entry->mclk.bclk_idx >= 0)
+		return true;
+
+	if (wm8960->prefer_mclk && wm8960->clk_table_direct)
+		return false;
+
+	return entry->pll.bclk_idx >= 0;
+}
+
+/*
+ * The clock table is keyed on the significant bits of the format, which
+ * is what hw_params clocks, rather than on its size in memory.
+ */
+static bool wm8960_format_allowed(struct wm8960_priv *wm8960, int r,
+				  snd_pcm_format_t format)
+{
+	int width = snd_pcm_format_width(format);
+	int w;
+
+	for (w = 0; w < ARRAY_SIZE(wm8960_clk_table_widths); w++)
+		if (wm8960_clk_table_widths[w] == width)
+			return wm8960_clk_allowed(wm8960, r, w);
+
+	return false;
+}
+
+static int wm8960_hw_rule_rate(struct snd_pcm_hw_params *params,
+			       struct snd_pcm_hw_rule *rule)
+{
+	struct wm8960_priv *wm8960 = rule->private;
+	const struct snd_mask *fmt =
+		hw_param_mask_c(params, SNDRV_PCM_HW_PARAM_FORMAT);
+	unsigned int list[ARRAY_SIZE(wm8960_clk_table_rates)];
+	unsigned int count = 0;
+	int f, r;
+
+	for (r = 0; r < ARRAY_SIZE(wm8960_clk_table_rates); r++) {
+		for (f = 0; f <= (__force int)SNDRV_PCM_FORMAT_LAST; f++)
+			if (snd_mask_test(fmt, f) &&
+			    wm8960_format_allowed(wm8960, r,
+						   (__force snd_pcm_format_t)f))
+				break;
+		if (f <= (__force int)SNDRV_PCM_FORMAT_LAST)
+			list[count++] = wm8960_clk_table_rates[r];
+	}
+
+	return snd_interval_list(hw_param_interval(params,
+						   SNDRV_PCM_HW_PARAM_RATE),
+				 count, list, 0);
+}
+
+static int wm8960_hw_rule_format(struct snd_pcm_hw_params *params,
+				 struct snd_pcm_hw_rule *rule)
+{
+	struct wm8960_priv *wm8960 = rule->private;
+	const struct snd_interval *rate =
+		hw_param_interval_c(params, SNDRV_PCM_HW_PARAM_RATE);
+	struct snd_mask *fmt = hw_param_mask(params, SNDRV_PCM_HW_PARAM_FORMAT);
+	struct snd_mask allowed;
+	int f, r;
+
+	snd_mask_none(&allowed);
+
+	for (f = 0; f <= (__force int)SNDRV_PCM_FORMAT_LAST; f++) {
+		if (!snd_mask_test(fmt, f))
+			continue;
+
+		for (r = 0; r < ARRAY_SIZE(wm8960_clk_table_rates); r++)
+			if (snd_interval_test(rate, wm8960_clk_table_rates[r]) &&
+			    wm8960_format_allowed(wm8960, r,
+						   (__force snd_pcm_format_t)f))
+				break;
+		if (r < ARRAY_SIZE(wm8960_clk_table_rates))
+			snd_mask_set(&allowed, f);
+	}
+
+	return snd_mask_refine(fmt, &allowed);
+}
+
+/*
+ * Check that the dividers for the current lrclk/bclk can be found with
+ * the configured clock source, so that hw_params fails rather than the
+ * later bias change. Nothing can be checked before MCLK is known.
+ */
+static int wm8960_check_clocking(struct wm8960_priv *wm8960)
+{
+	struct wm8960_clk_sol sol;
+	int mclk;
+
+	if (wm8960->clk_id == WM8960_SYSCLK_AUTO)
+		mclk = wm8960->freq_in;
+	else
+		mclk = wm8960->sysclk;
+
+	if (wm8960->clk_id == WM8960_SYSCLK_MCLK ? !mclk : !wm8960->freq_in)
+		return 0;
+
+	wm8960_update_clk_table(wm8960);
+
+	if (wm8960->clk_id != WM8960_SYSCLK_PLL &&
+	    !wm8960_find_clk_sol(wm8960, mclk, false, &sol))
+		return 0;
+
+	if (wm8960->clk_id != WM8960_SYSCLK_MCLK &&
+	    !wm8960_find_clk_sol(wm8960, wm8960->freq_in, true, &sol))
+		return 0;
+
+	return -EINVAL;
+}
+
+/*
+ * With separate ADC and DAC frame clocks, the DAC side follows the
+ * playback stream and the ADC side the capture stream, an idle direction
+ * following the other one. BCLK has to serve the faster of the two.
+ */
+static void wm8960_select_rates(struct wm8960_priv *wm8960)
+{
+	bool play = wm8960->is_stream_in_use[1];
+	bool cap = wm8960->is_stream_in_use[0];
+
+	if (!play && !cap)
+		return;
+
+	wm8960->lrclk = wm8960->stream_lrclk[play ? 1 : 0];
+	wm8960->adc_lrclk = wm8960->stream_lrclk[cap ? 0 : 1];
+	wm8960->bclk = max(play ? wm8960->stream_bclk[1] : 0,
+			   cap ? wm8960->stream_bclk[0] : 0);
+}
+
+/*
+ * Give a stream starting while the other direction is already clocked
+ * its own frame clock divider, provided the running SYSCLK and BCLK can
+ * serve it without disturbing the other stream.
+ */
+static int wm8960_set_stream_div(struct snd_soc_component *component,
+				 bool tx)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	int bclk_idx = snd_soc_component_read(component, WM8960_CLOCK2) & 0xf;
+	int rate = wm8960->stream_lrclk[tx];
+	int j;
+
+	for (j = 0; j < ARRAY_SIZE(dac_divs); j++)
+		if (rate * dac_divs[j] == wm8960->sysclk_rate)
+			break;
+
+	if (j == ARRAY_SIZE(dac_divs) ||
+	    wm8960->stream_bclk[tx] >
+	    wm8960->sysclk_rate / bclk_divs[bclk_idx] * 10) {
+		dev_err(component->dev,
+			"cannot clock %d Hz alongside the running stream\n",
+			rate);
+		return -EINVAL;
+	}
+
+	if (tx)
+		return wm8960_update_reg(component, WM8960_CLOCK1, 0x7 << 3,
+					 j << 3);
+
+	return wm8960_update_reg(component, WM8960_CLOCK1, 0x7 << 6, j << 6);
+}
+
+/*
+ * When MCLK is adjustable, ask the clock provider for the first rate of
+ * wlf,mclk-rates that clocks the stream without the PLL. The current
+ * rate is kept when it already does, when MCLK is in use by the other
+ * direction, or when other codecs of the clock domain share it, as they
+ * would be left set up for the old rate. The PLL is left to make up for
+ * a provider that refuses every rate.
+ */
+static void wm8960_negotiate_mclk(struct snd_soc_component *component,
+				  bool tx)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	struct wm8960_clk_sol sol;
+	unsigned long rate;
+	bool shared = false;
+	int *freq;
+	int i;
+
+	if (!wm8960->num_mclk_rates || IS_ERR(wm8960->mclk))
+		return;
+
+	if (wm8960->clk_id == WM8960_SYSCLK_AUTO)
+		freq = &wm8960->freq_in;
+	else if (wm8960->clk_id == WM8960_SYSCLK_MCLK)
+		freq = &wm8960->sysclk;
+	else
+		return;
+
+	if (*freq && !wm8960_find_clk_sol(wm8960, *freq, false, &sol))
+		return;
+
+	if (wm8960->clk_domain) {
+		mutex_lock(&wm8960_clk_domain_lock);
+		shared = !list_is_singular(&wm8960->clk_domain->members);
+		mutex_unlock(&wm8960_clk_domain_lock);
+	}
+	if (shared || wm8960->is_stream_in_use[!tx])
+		return;
+
+	for (i = 0; i < wm8960->num_mclk_rates; i++) {
+		rate = wm8960->mclk_rates[i];
+		if (wm8960_find_clk_sol(wm8960, rate, false, &sol))
+			continue;
+
+		if (!clk_set_rate(wm8960->mclk, rate) &&
+		    clk_get_rate(wm8960->mclk) == rate)
+			break;
+
+		dev_dbg(component->dev, "MCLK rate %lu Hz refused\n", rate);
+	}
+
+	/* Solve for whatever rate the provider ended up at */
+	rate = clk_get_rate(wm8960->mclk);
+	if (rate) {
+		dev_dbg(component->dev, "MCLK at %lu Hz\n", rate);
+		*freq = rate;
+	}
 }
+
 static int wm8960_configure_clocking(struct snd_soc_component *component)
 {
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	struct wm8960_clk_sol sol;
 	int freq_out, freq_in;
-	u16 iface1 = snd_soc_component_read(component, WM8960_IFACE1);
-	int i, j, k;
 	int ret;
 
 	if (wm8960->clk_id != WM8960_SYSCLK_MCLK && !wm8960->freq_in) {
@@ -766,8 +2131,6 @@ static int wm8960_configure_clocking(struct snd_soc_component *component)
 	 * and set PLL.
 	 */
 	if (wm8960->clk_id == WM8960_SYSCLK_AUTO) {
-		/* disable the PLL and using MCLK to provide sysclk */
-		wm8960_set_pll(component, 0, 0);
 		freq_out = freq_in;
 	} else if (wm8960->sysclk) {
 		freq_out = wm8960->sysclk;
@@ -776,35 +2139,100 @@ static int wm8960_configure_clocking(struct snd_soc_component *component)
 		return -EINVAL;
 	}
 
+	if (wm8960->asym_rates)
+		wm8960_select_rates(wm8960);
+
+	wm8960_update_clk_table(wm8960);
+
+	/* Follow the other clocked codecs sharing our MCLK */
+	ret = wm8960_domain_get_sol(wm8960, &sol);
+	if (ret < 0)
+		return ret;
+	if (ret > 0)
+		goto claim;
+
 	if (wm8960->clk_id != WM8960_SYSCLK_PLL) {
-		ret = wm8960_configure_sysclk(wm8960, freq_out, &i, &j, &k);
+		ret = wm8960_find_clk_sol(wm8960, freq_out, false, &sol);
 		if (ret >= 0) {
-			goto configure_clock;
+			goto claim;
 		} else if (wm8960->clk_id != WM8960_SYSCLK_AUTO) {
 			dev_err(component->dev, "failed to configure clock\n");
 			return -EINVAL;
 		}
 	}
 
-	freq_out = wm8960_configure_pll(component, freq_in, &i, &j, &k);
-	if (freq_out < 0) {
+	ret = wm8960_find_clk_sol(wm8960, freq_in, true, &sol);
+	if (ret < 0) {
 		dev_err(component->dev, "failed to configure clock via PLL\n");
-		return freq_out;
+		return ret;
 	}
-	wm8960_set_pll(component, freq_in, freq_out);
 
-configure_clock:
-	/* configure sysclk clock */
-	snd_soc_component_update_bits(component, WM8960_CLOCK1, 3 << 1, i << 1);
+claim:
+	ret = wm8960_domain_claim(wm8960, &sol);
+	if (ret)
+		return ret;
+
+	if (sol.freq_out)
+		ret = wm8960_program_pll(component, &sol.pll_div);
+	else if (wm8960->clk_id == WM8960_SYSCLK_AUTO)
+		/* disable the PLL and using MCLK to provide sysclk */
+		ret = wm8960_program_pll(component, NULL);
+	if (ret) {
+		wm8960_domain_release(wm8960);
+		return ret;
+	}
+
+	wm8960->sysclk_rate = wm8960->lrclk * dac_divs[sol.dac_idx];
+	wm8960->clk_rate = wm8960->lrclk;
+	wm8960->clk_err_ppb = sol.err_ppb;
+	wm8960->clk_pll = sol.freq_out != 0;
 
-	/* configure frame clock */
-	snd_soc_component_update_bits(component, WM8960_CLOCK1, 0x7 << 3, j << 3);
-	snd_soc_component_update_bits(component, WM8960_CLOCK1, 0x7 << 6, j << 6);
+	wm8960_burst_begin(wm8960);
+
+	/* configure sysclk and frame clocks in a single write */
+	wm8960_update_reg(component, WM8960_CLOCK1,
+			  (0x7 << 6) | (0x7 << 3) | (3 << 1),
+			  (sol.adc_idx << 6) | (sol.dac_idx << 3) |
+			  (sol.sysclk_idx << 1));
 
 	/* configure bit clock */
-	snd_soc_component_update_bits(component, WM8960_CLOCK2, 0xf, k);
+	wm8960_update_reg(component, WM8960_CLOCK2, 0xf, sol.bclk_idx);
 
-	return 0;
+	return wm8960_burst_end(wm8960);
+}
+
+/*
+ * Bit clock for a stream. Only the significant bits of each sample are
+ * clocked, whatever their size in memory (S24_LE and S24_3LE both give
+ * 24 bit words), and mono streams are clocked as stereo.
+ */
+static int wm8960_params_to_bclk(struct snd_pcm_hw_params *params)
+{
+	return 2 * params_rate(params) * params_width(params);
+}
+
+/*
+ * Mono streams use the codec's own mono handling: the DAC mixes both
+ * channels and the ADC sends the left channel data in both. The user's
+ * settings are put back once the stream is freed.
+ */
+static void wm8960_set_mono(struct snd_soc_component *component, bool tx,
+			    bool mono)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	unsigned int mask = tx ? WM8960_DMONOMIX : WM8960_DATSEL_MASK;
+	unsigned int val = tx ? WM8960_DMONOMIX : WM8960_DATSEL_LEFT;
+
+	if (mono && !wm8960->mono[tx]) {
+		wm8960->mono_saved[tx] =
+			snd_soc_component_read(component, WM8960_ADDCTL1) & mask;
+		wm8960_update_reg(component, WM8960_ADDCTL1, mask, val);
+	} else if (!mono && wm8960->mono[tx]) {
+		wm8960_update_reg(component, WM8960_ADDCTL1, mask,
+				  wm8960->mono_saved[tx]);
+	}
+
+	wm8960->mono[tx] = mono;
 }
 
 static int wm8960_hw_params(struct snd_pcm_substream *substream,
@@ -815,14 +2243,78 @@ static int wm8960_hw_params(struct snd_pcm_substream *substream,
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
 	u16 iface = snd_soc_component_read(component, WM8960_IFACE1) & 0xfff3;
 	bool tx = substream->stream == SNDRV_PCM_STREAM_PLAYBACK;
-	int i;
+	bool mono = params_channels(params) == 1;
+	bool single_slot = false;
+	int comp = 0, shift;
+	int i, j, ret;
+
+	wm8960->bclk = wm8960_params_to_bclk(params);
+
+	if (wm8960->tdm_slots) {
+		if ((iface & 0x3) != 0x3 ||
+		    (!mono && params_width(params) != wm8960->tdm_width) ||
+		    params_width(params) > wm8960->tdm_width) {
+			dev_err(component->dev,
+				"TDM needs DSP mode with %d bit words\n",
+				wm8960->tdm_width);
+			return -EINVAL;
+		}
 
-	wm8960->bclk = snd_soc_params_to_bclk(params);
-	if (params_channels(params) == 1)
-		wm8960->bclk *= 2;
+		/* BCLK cannot be faster than the fastest SYSCLK */
+		if (wm8960->tdm_slots * wm8960->tdm_width >
+		    dac_divs[ARRAY_SIZE(dac_divs) - 1]) {
+			dev_err(component->dev,
+				"TDM frame of %d x %d bits is too long\n",
+				wm8960->tdm_slots, wm8960->tdm_width);
+			return -EINVAL;
+		}
+
+		wm8960->bclk = params_rate(params) * wm8960->tdm_slots *
+			       wm8960->tdm_width;
+	}
+
+	/*
+	 * In DSP mode the right channel directly follows the left one, so a
+	 * mono stream only needs its own slot clocked. The other direction
+	 * has to fit in the same frame.
+	 */
+	if (mono && (iface & 0x3) == 0x3 && !wm8960->tdm_slots &&
+	    (!wm8960->is_stream_in_use[!tx] || wm8960->single_slot)) {
+		wm8960->bclk /= 2;
+		single_slot = true;
+	} else if (wm8960->is_stream_in_use[!tx] && wm8960->single_slot) {
+		dev_err(component->dev,
+			"only mono DSP streams fit alongside a mono stream\n");
+		return -EINVAL;
+	}
+
+	/* G.711 companding, on 8 bit words */
+	switch (params_format(params)) {
+	case SNDRV_PCM_FORMAT_MU_LAW:
+		comp = WM8960_COMP_ULAW;
+		break;
+	case SNDRV_PCM_FORMAT_A_LAW:
+		comp = WM8960_COMP_ALAW;
+		break;
+	default:
+		break;
+	}
+
+	/* the 8 bit word length is shared by both directions */
+	if (wm8960->is_stream_in_use[!tx] &&
+	    !comp != !(snd_soc_component_read(component, WM8960_IFACE2) &
+		       WM8960_WL8)) {
+		dev_err(component->dev,
+			"companded and linear streams cannot run together\n");
+		return -EINVAL;
+	}
 
 	/* bit size */
 	switch (params_width(params)) {
+	case 8:
+		if (!comp)
+			goto bad_width;
+		break;
 	case 16:
 		break;
 	case 20:
@@ -839,35 +2331,113 @@ static int wm8960_hw_params(struct snd_pcm_substream *substream,
 		}
 		/* fall through */
 	default:
+bad_width:
 		dev_err(component->dev, "unsupported width %d\n",
 			params_width(params));
 		return -EINVAL;
 	}
 
 	wm8960->lrclk = params_rate(params);
+	wm8960->adc_lrclk = 0;
+	wm8960->stream_lrclk[tx] = wm8960->lrclk;
+	wm8960->stream_bclk[tx] = wm8960->bclk;
+
+	wm8960_negotiate_mclk(component, tx);
+
+	ret = wm8960_check_clocking(wm8960);
+	if (ret) {
+		dev_err(component->dev, "no clock configuration for %d Hz, %d bits\n",
+			wm8960->lrclk, params_width(params));
+		return ret;
+	}
+
 	/* Update filters for the new rate */
 	if (tx) {
 		wm8960_set_deemph(component);
 	} else {
-		for (i = 0; i < ARRAY_SIZE(alc_rates); i++)
-			if (alc_rates[i].rate == params_rate(params))
-				snd_soc_component_update_bits(component,
-						    WM8960_ADDCTL3, 0x7,
-						    alc_rates[i].val);
+		/* Closest ALC setting, for rates off the standard ones */
+		for (i = 1, j = 0; i < ARRAY_SIZE(alc_rates); i++)
+			if (abs(alc_rates[i].rate - wm8960->lrclk) <
+			    abs(alc_rates[j].rate - wm8960->lrclk))
+				j = i;
+		wm8960_update_reg(component, WM8960_ADDCTL3, 0x7,
+				  alc_rates[j].val);
 	}
 
 	/* set iface */
-	snd_soc_component_write(component, WM8960_IFACE1, iface);
+	wm8960_write_reg(component, WM8960_IFACE1, iface);
+
+	shift = tx ? WM8960_DACCOMP_SHIFT : WM8960_ADCCOMP_SHIFT;
+	wm8960_update_reg(component, WM8960_IFACE2,
+			  WM8960_WL8 | (0x3 << shift),
+			  (comp ? WM8960_WL8 : 0) | (comp << shift));
 
+	wm8960_set_mono(component, tx, mono);
+
+	wm8960->single_slot = single_slot;
 	wm8960->is_stream_in_use[tx] = true;
+	wm8960_update_delay(component);
 
 	if (snd_soc_component_get_bias_level(component) == SND_SOC_BIAS_ON &&
-	    !wm8960->is_stream_in_use[!tx])
-		return wm8960_configure_clocking(component);
+	    !wm8960->is_stream_in_use[!tx]) {
+		ret = wm8960_configure_clocking(component);
+		if (ret)
+			return ret;
+
+		wm8960_finish_pll(component);
+	} else if (wm8960->asym_rates && wm8960->is_stream_in_use[!tx] &&
+		   snd_soc_component_get_bias_level(component) >=
+		   SND_SOC_BIAS_PREPARE) {
+		ret = wm8960_set_stream_div(component, tx);
+		if (ret)
+			return ret;
+	}
 
 	return 0;
 }
 
+static const struct snd_pcm_hw_constraint_list wm8960_rate_list = {
+	.count = ARRAY_SIZE(wm8960_clk_table_rates),
+	.list = wm8960_clk_table_rates,
+};
+
+/*
+ * Only offer the rates and word lengths the dividers can be set up for
+ * with the MCLK configured when the stream is opened.
+ */
+static int wm8960_startup(struct snd_pcm_substream *substream,
+			  struct snd_soc_dai *dai)
+{
+	struct snd_soc_component *component = dai->component;
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	int ret;
+
+	/* Any rate the PLL can reach is accepted, hw_params checks it */
+	if (wm8960->continuous_rates)
+		return 0;
+
+	ret = snd_pcm_hw_constraint_list(runtime, 0, SNDRV_PCM_HW_PARAM_RATE,
+					 &wm8960_rate_list);
+	if (ret < 0)
+		return ret;
+
+	/* The table only covers the current MCLK, which may be renegotiated */
+	if ((!wm8960->clk_table_mclk && !wm8960->clk_table_pll) ||
+	    wm8960->num_mclk_rates)
+		return 0;
+
+	ret = snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_RATE,
+				  wm8960_hw_rule_rate, wm8960,
+				  SNDRV_PCM_HW_PARAM_FORMAT, -1);
+	if (ret < 0)
+		return ret;
+
+	return snd_pcm_hw_rule_add(runtime, 0, SNDRV_PCM_HW_PARAM_FORMAT,
+				   wm8960_hw_rule_format, wm8960,
+				   SNDRV_PCM_HW_PARAM_RATE, -1);
+}
+
 static int wm8960_hw_free(struct snd_pcm_substream *substream,
 		struct snd_soc_dai *dai)
 {
@@ -875,31 +2445,175 @@ static int wm8960_hw_free(struct snd_pcm_substream *substream,
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
 	bool tx = substream->stream == SNDRV_PCM_STREAM_PLAYBACK;
 
-	wm8960->is_stream_in_use[tx] = false;
+	wm8960_set_mono(component, tx, false);
+
+	wm8960->is_stream_in_use[tx] = false;
+	if (!wm8960->is_stream_in_use[!tx])
+		wm8960->single_slot = false;
+	wm8960_update_delay(component);
+
+	return 0;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,0,0)
+static int wm8960_mute(struct snd_soc_dai *dai, int mute)
+#else
+static int wm8960_mute(struct snd_soc_dai *dai, int mute, int direction)
+#endif
+{
+	struct snd_soc_component *component = dai->component;
+
+	if (mute)
+		snd_soc_component_update_bits(component, WM8960_DACCTL1, 0x8, 0x8);
+	else
+		snd_soc_component_update_bits(component, WM8960_DACCTL1, 0x8, 0);
+	return 0;
+}
+
+/* Called with the stream lock held, so only the stored figure is used */
+static snd_pcm_sframes_t wm8960_delay(struct snd_pcm_substream *substream,
+				      struct snd_soc_dai *dai)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(dai->component);
+	bool tx = substream->stream == SNDRV_PCM_STREAM_PLAYBACK;
+
+	return READ_ONCE(wm8960->delay[tx]);
+}
+
+/*
+ * Release what streams needed once the codec is back in STANDBY: the
+ * PLL in auto mode and MCLK, plus VMID and VREF on capless boards.
+ */
+static void wm8960_cool_down(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	u16 pm2 = snd_soc_component_read(component, WM8960_POWER2);
+
+	/*
+	 * If it's sysclk auto mode, and the pll is enabled,
+	 * disable the pll
+	 */
+	if (wm8960->clk_id == WM8960_SYSCLK_AUTO && (pm2 & 0x1))
+		wm8960_set_pll(component, 0, 0);
+
+	if (!IS_ERR(wm8960->mclk))
+		clk_disable_unprepare(wm8960->mclk);
+
+	wm8960_domain_release(wm8960);
+
+	if (!wm8960->pdata.capless)
+		return;
+
+	wm8960_burst_begin(wm8960);
+
+	/* Enable anti-pop mode */
+	snd_soc_component_update_bits(component, WM8960_APOP1,
+			    WM8960_POBCTRL | WM8960_SOFT_ST |
+			    WM8960_BUFDCOPEN,
+			    WM8960_POBCTRL | WM8960_SOFT_ST |
+			    WM8960_BUFDCOPEN);
+
+	/* Disable VMID and VREF */
+	snd_soc_component_update_bits(component, WM8960_POWER1,
+			    WM8960_VREF | WM8960_VMID_MASK, 0);
+
+	wm8960_burst_end(wm8960);
+}
+
+/*
+ * The last stream went away: cool down now, or keep everything running
+ * for keep_warm_ms so that a following stream starts immediately. A PLL
+ * locked in auto mode is kept for WM8960_PLL_HOLD_MS even without it, as
+ * relocking costs every 44.1 kHz stream on a 12 MHz MCLK a quarter second.
+ */
+static void wm8960_stream_idle(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	unsigned int ms = wm8960->keep_warm_ms;
+
+	/* Keep an auto mode PLL locked for the next stream to reuse */
+	if (!ms && wm8960->clk_id == WM8960_SYSCLK_AUTO && wm8960->pll_locked)
+		ms = WM8960_PLL_HOLD_MS;
+
+	if (!ms) {
+		wm8960_cool_down(component);
+		return;
+	}
+
+	/* Idle clocks leave the domain free to be set up for another rate */
+	wm8960_domain_release(wm8960);
+
+	wm8960->clk_warm = true;
+	mod_delayed_work(system_wq, &wm8960->keep_warm_work,
+			 msecs_to_jiffies(ms));
+}
+
+/*
+ * Stop the keep warm timeout. Returns true if the clocks were still
+ * running, in which case the caller now owns them. They no longer hold
+ * the clock domain, wm8960_configure_clocking() claims it again.
+ */
+static bool wm8960_take_warm(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	bool warm;
+
+	cancel_delayed_work_sync(&wm8960->keep_warm_work);
+	warm = wm8960->clk_warm;
+	wm8960->clk_warm = false;
+
+	return warm;
+}
+
+static void wm8960_keep_warm_work(struct work_struct *work)
+{
+	struct wm8960_priv *wm8960 = container_of(to_delayed_work(work),
+						  struct wm8960_priv,
+						  keep_warm_work);
+
+	if (!wm8960->clk_warm)
+		return;
+
+	wm8960->clk_warm = false;
+	wm8960_cool_down(wm8960->component);
+}
+
+static int wm8960_out3_power_up(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	int ret;
+
+	/* Let a previous discharge finish before ramping up */
+	wait_for_completion(&wm8960->discharged);
 
-	return 0;
-}
+	ret = wm8960_sync(wm8960);
+	if (ret)
+		return ret;
 
-#if LINUX_VERSION_CODE < KERNEL_VERSION(5,0,0)
-static int wm8960_mute(struct snd_soc_dai *dai, int mute)
-#else
-static int wm8960_mute(struct snd_soc_dai *dai, int mute, int direction)
-#endif
-{
-	struct snd_soc_component *component = dai->component;
+	/* Enable anti-pop features */
+	snd_soc_component_write(component, WM8960_APOP1,
+		      WM8960_POBCTRL | WM8960_SOFT_ST |
+		      WM8960_BUFDCOPEN | WM8960_BUFIOEN);
 
-	if (mute)
-		snd_soc_component_update_bits(component, WM8960_DACCTL1, 0x8, 0x8);
-	else
-		snd_soc_component_update_bits(component, WM8960_DACCTL1, 0x8, 0);
-	return 0;
+	/* Enable & ramp VMID at 2x50k */
+	wm8960_ramp_vmid(component);
+
+	wm8960_burst_begin(wm8960);
+
+	/* Enable VREF */
+	snd_soc_component_update_bits(component, WM8960_POWER1, WM8960_VREF,
+			    WM8960_VREF);
+
+	/* Disable anti-pop features */
+	snd_soc_component_write(component, WM8960_APOP1, WM8960_BUFIOEN);
+
+	return wm8960_burst_end(wm8960);
 }
 
 static int wm8960_set_bias_level_out3(struct snd_soc_component *component,
 				      enum snd_soc_bias_level level)
 {
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
-	u16 pm2 = snd_soc_component_read(component, WM8960_POWER2);
 	int ret;
 
 	switch (level) {
@@ -909,7 +2623,8 @@ static int wm8960_set_bias_level_out3(struct snd_soc_component *component,
 	case SND_SOC_BIAS_PREPARE:
 		switch (snd_soc_component_get_bias_level(component)) {
 		case SND_SOC_BIAS_STANDBY:
-			if (!IS_ERR(wm8960->mclk)) {
+			if (!wm8960_take_warm(component) &&
+			    !IS_ERR(wm8960->mclk)) {
 				ret = clk_prepare_enable(wm8960->mclk);
 				if (ret) {
 					dev_err(component->dev,
@@ -919,24 +2634,23 @@ static int wm8960_set_bias_level_out3(struct snd_soc_component *component,
 				}
 			}
 
+			/* Set VMID to 2x50k */
+			snd_soc_component_update_bits(component, WM8960_POWER1, 0x180, 0x80);
+
 			ret = wm8960_configure_clocking(component);
-			if (ret)
+			if (ret) {
+				/* Back to STANDBY, MCLK is ours either way */
+				wm8960_cool_down(component);
+				snd_soc_component_update_bits(component, WM8960_POWER1, 0x180, 0x100);
 				return ret;
+			}
 
-			/* Set VMID to 2x50k */
-			snd_soc_component_update_bits(component, WM8960_POWER1, 0x180, 0x80);
+			/* Switch SYSCLK over before DAPM powers the DAC and ADC */
+			wm8960_finish_pll(component);
 			break;
 
 		case SND_SOC_BIAS_ON:
-			/*
-			 * If it's sysclk auto mode, and the pll is enabled,
-			 * disable the pll
-			 */
-			if (wm8960->clk_id == WM8960_SYSCLK_AUTO && (pm2 & 0x1))
-				wm8960_set_pll(component, 0, 0);
-
-			if (!IS_ERR(wm8960->mclk))
-				clk_disable_unprepare(wm8960->mclk);
+			wm8960_stream_idle(component);
 			break;
 
 		default:
@@ -947,23 +2661,9 @@ static int wm8960_set_bias_level_out3(struct snd_soc_component *component,
 
 	case SND_SOC_BIAS_STANDBY:
 		if (snd_soc_component_get_bias_level(component) == SND_SOC_BIAS_OFF) {
-			regcache_sync(wm8960->regmap);
-
-			/* Enable anti-pop features */
-			snd_soc_component_write(component, WM8960_APOP1,
-				      WM8960_POBCTRL | WM8960_SOFT_ST |
-				      WM8960_BUFDCOPEN | WM8960_BUFIOEN);
-
-			/* Enable & ramp VMID at 2x50k */
-			snd_soc_component_update_bits(component, WM8960_POWER1, 0x80, 0x80);
-			msleep(100);
-
-			/* Enable VREF */
-			snd_soc_component_update_bits(component, WM8960_POWER1, WM8960_VREF,
-					    WM8960_VREF);
-
-			/* Disable anti-pop features */
-			snd_soc_component_write(component, WM8960_APOP1, WM8960_BUFIOEN);
+			ret = wm8960_out3_power_up(component);
+			if (ret)
+				return ret;
 		}
 
 		/* Set VMID to 2x250k */
@@ -971,6 +2671,11 @@ static int wm8960_set_bias_level_out3(struct snd_soc_component *component,
 		break;
 
 	case SND_SOC_BIAS_OFF:
+		if (wm8960_take_warm(component))
+			wm8960_cool_down(component);
+
+		wm8960_burst_begin(wm8960);
+
 		/* Enable anti-pop features */
 		snd_soc_component_write(component, WM8960_APOP1,
 			     WM8960_POBCTRL | WM8960_SOFT_ST |
@@ -978,8 +2683,12 @@ static int wm8960_set_bias_level_out3(struct snd_soc_component *component,
 
 		/* Disable VMID and VREF, let them discharge */
 		snd_soc_component_write(component, WM8960_POWER1, 0);
-		msleep(600);
-		break;
+
+		ret = wm8960_burst_end(wm8960);
+		reinit_completion(&wm8960->discharged);
+		mod_delayed_work(system_wq, &wm8960->discharge_work,
+				 msecs_to_jiffies(WM8960_DISCHARGE_MS));
+		return ret;
 	}
 
 	return 0;
@@ -989,7 +2698,7 @@ static int wm8960_set_bias_level_capless(struct snd_soc_component *component,
 					 enum snd_soc_bias_level level)
 {
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
-	u16 pm2 = snd_soc_component_read(component, WM8960_POWER2);
+	bool warm;
 	int reg, ret;
 
 	switch (level) {
@@ -999,6 +2708,10 @@ static int wm8960_set_bias_level_capless(struct snd_soc_component *component,
 	case SND_SOC_BIAS_PREPARE:
 		switch (snd_soc_component_get_bias_level(component)) {
 		case SND_SOC_BIAS_STANDBY:
+			warm = wm8960_take_warm(component);
+
+			wm8960_burst_begin(wm8960);
+
 			/* Enable anti pop mode */
 			snd_soc_component_update_bits(component, WM8960_APOP1,
 					    WM8960_POBCTRL | WM8960_SOFT_ST |
@@ -1019,20 +2732,11 @@ static int wm8960_set_bias_level_capless(struct snd_soc_component *component,
 					    WM8960_PWR2_ROUT1 |
 					    WM8960_PWR2_OUT3, reg);
 
-			/* Enable VMID at 2*50k */
-			snd_soc_component_update_bits(component, WM8960_POWER1,
-					    WM8960_VMID_MASK, 0x80);
-
-			/* Ramp */
-			msleep(100);
-
-			/* Enable VREF */
-			snd_soc_component_update_bits(component, WM8960_POWER1,
-					    WM8960_VREF, WM8960_VREF);
-
-			msleep(100);
+			ret = wm8960_burst_end(wm8960);
+			if (ret)
+				return ret;
 
-			if (!IS_ERR(wm8960->mclk)) {
+			if (!warm && !IS_ERR(wm8960->mclk)) {
 				ret = clk_prepare_enable(wm8960->mclk);
 				if (ret) {
 					dev_err(component->dev,
@@ -1042,38 +2746,38 @@ static int wm8960_set_bias_level_capless(struct snd_soc_component *component,
 				}
 			}
 
+			/* Start clocking so the PLL locks during the ramp */
 			ret = wm8960_configure_clocking(component);
-			if (ret)
+			if (ret) {
+				/* Back to STANDBY, MCLK is ours either way */
+				wm8960_cool_down(component);
 				return ret;
+			}
 
-			break;
+			/* VMID and VREF are still up when warm */
+			if (!warm) {
+				/* Enable and ramp VMID to 2*50k */
+				wm8960_ramp_vmid(component);
 
-		case SND_SOC_BIAS_ON:
-			/*
-			 * If it's sysclk auto mode, and the pll is enabled,
-			 * disable the pll
-			 */
-			if (wm8960->clk_id == WM8960_SYSCLK_AUTO && (pm2 & 0x1))
-				wm8960_set_pll(component, 0, 0);
+				/* Enable VREF */
+				snd_soc_component_update_bits(component,
+						    WM8960_POWER1,
+						    WM8960_VREF, WM8960_VREF);
 
-			if (!IS_ERR(wm8960->mclk))
-				clk_disable_unprepare(wm8960->mclk);
+				wm8960_wait_until(ktime_add_ms(ktime_get(),
+						  WM8960_VREF_SETTLE_MS));
+			}
 
-			/* Enable anti-pop mode */
-			snd_soc_component_update_bits(component, WM8960_APOP1,
-					    WM8960_POBCTRL | WM8960_SOFT_ST |
-					    WM8960_BUFDCOPEN,
-					    WM8960_POBCTRL | WM8960_SOFT_ST |
-					    WM8960_BUFDCOPEN);
+			/* Switch SYSCLK over before DAPM powers the DAC and ADC */
+			wm8960_finish_pll(component);
+			break;
 
-			/* Disable VMID and VREF */
-			snd_soc_component_update_bits(component, WM8960_POWER1,
-					    WM8960_VREF | WM8960_VMID_MASK, 0);
+		case SND_SOC_BIAS_ON:
+			wm8960_stream_idle(component);
 			break;
 
 		case SND_SOC_BIAS_OFF:
-			regcache_sync(wm8960->regmap);
-			break;
+			return wm8960_sync(wm8960);
 		default:
 			break;
 		}
@@ -1082,6 +2786,8 @@ static int wm8960_set_bias_level_capless(struct snd_soc_component *component,
 	case SND_SOC_BIAS_STANDBY:
 		switch (snd_soc_component_get_bias_level(component)) {
 		case SND_SOC_BIAS_PREPARE:
+			wm8960_burst_begin(wm8960);
+
 			/* Disable HP discharge */
 			snd_soc_component_update_bits(component, WM8960_APOP2,
 					    WM8960_DISOP | WM8960_DRES_MASK,
@@ -1093,7 +2799,8 @@ static int wm8960_set_bias_level_capless(struct snd_soc_component *component,
 					    WM8960_BUFDCOPEN,
 					    WM8960_POBCTRL | WM8960_SOFT_ST |
 					    WM8960_BUFDCOPEN);
-			break;
+
+			return wm8960_burst_end(wm8960);
 
 		default:
 			break;
@@ -1101,19 +2808,14 @@ static int wm8960_set_bias_level_capless(struct snd_soc_component *component,
 		break;
 
 	case SND_SOC_BIAS_OFF:
+		if (wm8960_take_warm(component))
+			wm8960_cool_down(component);
 		break;
 	}
 
 	return 0;
 }
 
-/* PLL divisors */
-struct _pll_div {
-	u32 pre_div:1;
-	u32 n:4;
-	u32 k:24;
-};
-
 static bool is_pll_freq_available(unsigned int source, unsigned int target)
 {
 	unsigned int Ndiv;
@@ -1187,44 +2889,217 @@ static int pll_factors(unsigned int source, unsigned int target,
 	return 0;
 }
 
-static int wm8960_set_pll(struct snd_soc_component *component,
-		unsigned int freq_in, unsigned int freq_out)
+/*
+ * Fractional part of the PLL divisors moved by ppm. The integer part N
+ * has to stay the same for the change to be glitch-free, and the PLL
+ * must already run in fractional mode.
+ */
+static int wm8960_pll_trim_k(const struct _pll_div *pll_div, int ppm, u32 *k)
+{
+	s64 f = ((s64)pll_div->n << 24) + pll_div->k;
+
+	*k = pll_div->k;
+	if (!ppm)
+		return 0;
+
+	if (!pll_div->k)
+		return -EINVAL;
+
+	f += div_s64(f * ppm, 1000000) - ((s64)pll_div->n << 24);
+	if (f <= 0 || f >= 1 << 24)
+		return -ERANGE;
+
+	*k = f;
+	return 0;
+}
+
+static int wm8960_write_pll_k(struct snd_soc_component *component, u32 k)
+{
+	wm8960_write_reg(component, WM8960_PLL2, (k >> 16) & 0xff);
+	wm8960_write_reg(component, WM8960_PLL3, (k >> 8) & 0xff);
+	return wm8960_write_reg(component, WM8960_PLL4, k & 0xff);
+}
+
+/*
+ * Walk the running PLL's K over to a new value one byte boundary at a
+ * time. K goes out a byte per register, so while a step is half written
+ * the PLL briefly runs with a mix of old and new bytes. Steps that cross
+ * at most one boundary keep that mix within 255 LSB of K, under 3 ppm,
+ * where a direct 50 ppm jump is off by thousands. The exception is a
+ * carry into the top byte, every 65536 LSB or a few times over the whole
+ * trim range: for the one register write in between, K is off by up to
+ * 65535 LSB.
+ */
+static int wm8960_step_pll_k(struct snd_soc_component *component, int from,
+			     int to)
+{
+	int k = from;
+	int ret = 0;
+
+	while (k != to && !ret) {
+		if (to > k)
+			k = min(to, (k | 0xff) + 1);
+		else
+			k = max(to, (k & ~0xff) - 1);
+
+		ret = wm8960_write_pll_k(component, k);
+	}
+
+	return ret;
+}
+
+/*
+ * Nudge the running PLL by only rewriting K, which it follows without
+ * relocking. The steps go out in one burst so that each only lasts a
+ * few bus cycles. When the PLL is not running the trim is kept for the
+ * next time it is programmed.
+ */
+static int wm8960_trim_pll(struct snd_soc_component *component, int ppm)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	u32 k, from;
+	int ret = 0;
+
+	mutex_lock(&wm8960->pll_lock);
+
+	if (wm8960->pll_locked &&
+	    (snd_soc_component_read(component, WM8960_POWER2) & 0x1)) {
+		ret = wm8960_pll_trim_k(&wm8960->pll_div, ppm, &k);
+		if (ret) {
+			dev_err(component->dev,
+				"PLL cannot be trimmed by %d ppm\n", ppm);
+			goto out;
+		}
+		from = (snd_soc_component_read(component, WM8960_PLL2) & 0xff) << 16 |
+		       (snd_soc_component_read(component, WM8960_PLL3) & 0xff) << 8 |
+		       (snd_soc_component_read(component, WM8960_PLL4) & 0xff);
+
+		wm8960_burst_begin(wm8960);
+		wm8960_step_pll_k(component, from, k);
+		ret = wm8960_burst_end(wm8960);
+		if (ret)
+			goto out;
+	}
+
+	wm8960->pll_trim_ppm = ppm;
+out:
+	mutex_unlock(&wm8960->pll_lock);
+
+	return ret;
+}
+
+static int __wm8960_program_pll(struct snd_soc_component *component,
+		const struct _pll_div *pll_div)
 {
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
 	u16 reg;
-	static struct _pll_div pll_div;
+	u32 k;
 	int ret;
 
-	if (freq_in && freq_out) {
-		ret = pll_factors(freq_in, freq_out, &pll_div);
-		if (ret != 0)
-			return ret;
+	/* Reuse the PLL if it is already locked with the same divisors */
+	if (pll_div && wm8960->pll_locked &&
+	    (snd_soc_component_read(component, WM8960_POWER2) & 0x1) &&
+	    wm8960->pll_div.pre_div == pll_div->pre_div &&
+	    wm8960->pll_div.n == pll_div->n &&
+	    wm8960->pll_div.k == pll_div->k) {
+		if (!wm8960->pll_pending)
+			wm8960_update_reg(component, WM8960_CLOCK1, 0x1, 0x1);
+		return 0;
 	}
 
+	wm8960_burst_begin(wm8960);
+
 	/* Disable the PLL: even if we are changing the frequency the
 	 * PLL needs to be disabled while we do so. */
-	snd_soc_component_update_bits(component, WM8960_CLOCK1, 0x1, 0);
-	snd_soc_component_update_bits(component, WM8960_POWER2, 0x1, 0);
+	wm8960_update_reg(component, WM8960_CLOCK1, 0x1, 0);
+	wm8960_update_reg(component, WM8960_POWER2, 0x1, 0);
+	wm8960->pll_locked = false;
+	wm8960->pll_pending = false;
 
-	if (!freq_in || !freq_out)
-		return 0;
+	if (!pll_div)
+		return wm8960_burst_end(wm8960);
 
 	reg = snd_soc_component_read(component, WM8960_PLL1) & ~0x3f;
-	reg |= pll_div.pre_div << 4;
-	reg |= pll_div.n;
+	reg |= pll_div->pre_div << 4;
+	reg |= pll_div->n;
 
-	if (pll_div.k) {
+	if (pll_div->k) {
 		reg |= 0x20;
 
-		snd_soc_component_write(component, WM8960_PLL2, (pll_div.k >> 16) & 0xff);
-		snd_soc_component_write(component, WM8960_PLL3, (pll_div.k >> 8) & 0xff);
-		snd_soc_component_write(component, WM8960_PLL4, pll_div.k & 0xff);
+		/* Keep the runtime trim if it still fits the new divisors */
+		if (wm8960_pll_trim_k(pll_div, wm8960->pll_trim_ppm, &k)) {
+			k = pll_div->k;
+			wm8960->pll_trim_ppm = 0;
+		}
+		wm8960_write_pll_k(component, k);
+	} else {
+		wm8960->pll_trim_ppm = 0;
 	}
-	snd_soc_component_write(component, WM8960_PLL1, reg);
+	wm8960_write_reg(component, WM8960_PLL1, reg);
 
-	/* Turn it on */
+	/*
+	 * Turn it on. SYSCLK is switched over by wm8960_finish_pll() once
+	 * the PLL has locked, which lets callers overlap the lock time
+	 * with other power-up steps.
+	 */
 	snd_soc_component_update_bits(component, WM8960_POWER2, 0x1, 0x1);
-	msleep(250);
+
+	ret = wm8960_burst_end(wm8960);
+	if (ret)
+		return ret;
+
+	wm8960->pll_ready = ktime_add_ms(ktime_get(), WM8960_PLL_LOCK_MS);
+	wm8960->pll_pending = true;
+
+	wm8960->pll_div = *pll_div;
+	wm8960->pll_locked = true;
+
+	return 0;
+}
+
+static int wm8960_program_pll(struct snd_soc_component *component,
+		const struct _pll_div *pll_div)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	int ret;
+
+	mutex_lock(&wm8960->pll_lock);
+	ret = __wm8960_program_pll(component, pll_div);
+	mutex_unlock(&wm8960->pll_lock);
+
+	return ret;
+}
+
+static void wm8960_finish_pll(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	if (!wm8960->pll_pending)
+		return;
+
+	wm8960_wait_until(wm8960->pll_ready);
 	snd_soc_component_update_bits(component, WM8960_CLOCK1, 0x1, 0x1);
+	wm8960->pll_pending = false;
+}
+
+static int wm8960_set_pll(struct snd_soc_component *component,
+		unsigned int freq_in, unsigned int freq_out)
+{
+	struct _pll_div pll_div;
+	int ret;
+
+	if (!freq_in || !freq_out)
+		return wm8960_program_pll(component, NULL);
+
+	ret = pll_factors(freq_in, freq_out, &pll_div);
+	if (ret != 0)
+		return ret;
+
+	ret = wm8960_program_pll(component, &pll_div);
+	if (ret != 0)
+		return ret;
+
+	wm8960_finish_pll(component);
 
 	return 0;
 }
@@ -1236,6 +3111,7 @@ static int wm8960_set_dai_pll(struct snd_soc_dai *codec_dai, int pll_id,
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
 
 	wm8960->freq_in = freq_in;
+	wm8960_update_clk_table(wm8960);
 
 	if (pll_id == WM8960_SYSCLK_AUTO)
 		return 0;
@@ -1247,28 +3123,22 @@ static int wm8960_set_dai_clkdiv(struct snd_soc_dai *codec_dai,
 		int div_id, int div)
 {
 	struct snd_soc_component *component = codec_dai->component;
-	u16 reg;
 
 	switch (div_id) {
 	case WM8960_SYSCLKDIV:
-		reg = snd_soc_component_read(component, WM8960_CLOCK1) & 0x1f9;
-		snd_soc_component_write(component, WM8960_CLOCK1, reg | div);
+		wm8960_update_reg(component, WM8960_CLOCK1, 0x006, div);
 		break;
 	case WM8960_DACDIV:
-		reg = snd_soc_component_read(component, WM8960_CLOCK1) & 0x1c7;
-		snd_soc_component_write(component, WM8960_CLOCK1, reg | div);
+		wm8960_update_reg(component, WM8960_CLOCK1, 0x038, div);
 		break;
 	case WM8960_OPCLKDIV:
-		reg = snd_soc_component_read(component, WM8960_PLL1) & 0x03f;
-		snd_soc_component_write(component, WM8960_PLL1, reg | div);
+		wm8960_update_reg(component, WM8960_PLL1, 0x1c0, div);
 		break;
 	case WM8960_DCLKDIV:
-		reg = snd_soc_component_read(component, WM8960_CLOCK2) & 0x03f;
-		snd_soc_component_write(component, WM8960_CLOCK2, reg | div);
+		wm8960_update_reg(component, WM8960_CLOCK2, 0x1c0, div);
 		break;
 	case WM8960_TOCLKSEL:
-		reg = snd_soc_component_read(component, WM8960_ADDCTL1) & 0x1fd;
-		snd_soc_component_write(component, WM8960_ADDCTL1, reg | div);
+		wm8960_update_reg(component, WM8960_ADDCTL1, 0x002, div);
 		break;
 	default:
 		return -EINVAL;
@@ -1277,10 +3147,56 @@ static int wm8960_set_dai_clkdiv(struct snd_soc_dai *codec_dai,
 	return 0;
 }
 
+/*
+ * Bring the chip back from system suspend. Until a stream starts it is
+ * left off, with register writes going to the cache only; then the chip
+ * is reset and only the registers that differ from their reset defaults
+ * are sent, in one burst. The reset matters when the supplies stayed up,
+ * as the chip then still holds its values from before suspend.
+ */
+static int wm8960_resync(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	ktime_t start = ktime_get();
+	int ret = 0;
+
+	regcache_cache_only(wm8960->regmap, false);
+
+	ret = wm8960_reset(wm8960->regmap);
+	if (ret) {
+		dev_err(component->dev, "Failed to reset after resume: %d\n",
+			ret);
+		return ret;
+	}
+	wm8960->resync = false;
+
+	if (wm8960->pdata.capless)
+		ret = wm8960_sync(wm8960);
+	else
+		ret = wm8960_out3_power_up(component);
+
+	wm8960->resync_us = ktime_us_delta(ktime_get(), start);
+	dev_dbg(component->dev, "Resynced %lld ms after resume in %u us\n",
+		ktime_ms_delta(start, wm8960->resumed), wm8960->resync_us);
+
+	return ret;
+}
+
 static int wm8960_set_bias_level(struct snd_soc_component *component,
 				 enum snd_soc_bias_level level)
 {
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+	int ret;
+
+	if (wm8960->resync) {
+		/* Still off since suspend, nothing to do without a stream */
+		if (level < SND_SOC_BIAS_PREPARE)
+			return 0;
+
+		ret = wm8960_resync(component);
+		if (ret)
+			return ret;
+	}
 
 	return wm8960->set_bias_level(component, level);
 }
@@ -1313,25 +3229,32 @@ static int wm8960_set_dai_sysclk(struct snd_soc_dai *dai, int clk_id,
 
 	wm8960->sysclk = freq;
 	wm8960->clk_id = clk_id;
+	wm8960_update_clk_table(wm8960);
 
 	return 0;
 }
 
-#define WM8960_RATES SNDRV_PCM_RATE_8000_48000
+/* 8 kHz to 48 kHz including 12 kHz and 24 kHz, see wm8960_rate_list */
+#define WM8960_RATES SNDRV_PCM_RATE_KNOT
 
 #define WM8960_FORMATS \
 	(SNDRV_PCM_FMTBIT_S16_LE | SNDRV_PCM_FMTBIT_S20_3LE | \
-	SNDRV_PCM_FMTBIT_S24_LE | SNDRV_PCM_FMTBIT_S32_LE)
+	SNDRV_PCM_FMTBIT_S24_LE | SNDRV_PCM_FMTBIT_S24_3LE | \
+	SNDRV_PCM_FMTBIT_S32_LE | SNDRV_PCM_FMTBIT_MU_LAW | \
+	SNDRV_PCM_FMTBIT_A_LAW)
 
 static const struct snd_soc_dai_ops wm8960_dai_ops = {
+	.startup = wm8960_startup,
 	.hw_params = wm8960_hw_params,
 	.hw_free = wm8960_hw_free,
+	.delay = wm8960_delay,
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,0,0)
 	.digital_mute = wm8960_mute,
 #else
 	.mute_stream = wm8960_mute,
 #endif
 	.set_fmt = wm8960_set_dai_fmt,
+	.set_tdm_slot = wm8960_set_dai_tdm_slot,
 	.set_clkdiv = wm8960_set_dai_clkdiv,
 	.set_pll = wm8960_set_dai_pll,
 	.set_sysclk = wm8960_set_dai_sysclk,
@@ -1344,12 +3267,16 @@ static struct snd_soc_dai_driver wm8960_dai = {
 		.channels_min = 1,
 		.channels_max = 2,
 		.rates = WM8960_RATES,
+		.rate_min = 8000,
+		.rate_max = 48000,
 		.formats = WM8960_FORMATS,},
 	.capture = {
 		.stream_name = "Capture",
 		.channels_min = 1,
 		.channels_max = 2,
 		.rates = WM8960_RATES,
+		.rate_min = 8000,
+		.rate_max = 48000,
 		.formats = WM8960_FORMATS,},
 	.ops = &wm8960_dai_ops,
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5,15,0)
@@ -1359,11 +3286,70 @@ static struct snd_soc_dai_driver wm8960_dai = {
 #endif
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int wm8960_clk_table_show(struct seq_file *s, void *data)
+{
+	struct wm8960_priv *wm8960 = s->private;
+	const struct wm8960_clk_entry *entry;
+	const struct wm8960_clk_sol *sol;
+	int r, w;
+
+	seq_printf(s, "mclk %d Hz, pll in %d Hz\n",
+		   wm8960->clk_table_mclk, wm8960->clk_table_pll);
+	seq_puts(s, "rate   bclk    | mclk sysdiv dacdiv bclkdiv | pll freq_out  pre n k\n");
+
+	for (r = 0; r < ARRAY_SIZE(wm8960_clk_table_rates); r++) {
+		for (w = 0; w < ARRAY_SIZE(wm8960_clk_table_widths); w++) {
+			entry = &wm8960->clk_table[r][w];
+			seq_printf(s, "%-6u %-7u |",
+				   wm8960_clk_table_rates[r],
+				   2 * wm8960_clk_table_rates[r] *
+				   wm8960_clk_table_widths[w]);
+
+			sol = &entry->mclk;
+			if (sol->bclk_idx >= 0)
+				seq_printf(s, " %11d %6d %5d.%d |",
+					   sysclk_divs[sol->sysclk_idx],
+					   dac_divs[sol->dac_idx],
+					   bclk_divs[sol->bclk_idx] / 10,
+					   bclk_divs[sol->bclk_idx] % 10);
+			else
+				seq_puts(s, "           -      -       - |");
+
+			sol = &entry->pll;
+			if (sol->bclk_idx >= 0)
+				seq_printf(s, " %12d %3d %d %06x\n",
+					   sol->freq_out, sol->pll_div.pre_div,
+					   sol->pll_div.n, sol->pll_div.k);
+			else
+				seq_puts(s, "            -\n");
+		}
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wm8960_clk_table);
+
+static int wm8960_clk_error_show(struct seq_file *s, void *data)
+{
+	struct wm8960_priv *wm8960 = s->private;
+
+	seq_printf(s, "rate %d Hz, effective %d Hz, error %d ppb, trim %d ppm\n",
+		   wm8960->clk_rate, wm8960_effective_rate(wm8960),
+		   wm8960_rate_error(wm8960), wm8960->pll_trim_ppm);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wm8960_clk_error);
+#endif
+
 static int wm8960_probe(struct snd_soc_component *component)
 {
 	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
 	struct wm8960_data *pdata = &wm8960->pdata;
 
+	wm8960->component = component;
+
 	if (pdata->capless)
 		wm8960->set_bias_level = wm8960_set_bias_level_capless;
 	else
@@ -1373,11 +3359,55 @@ static int wm8960_probe(struct snd_soc_component *component)
 				     ARRAY_SIZE(wm8960_snd_controls));
 	wm8960_add_widgets(component);
 
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("clk_table", 0444, component->debugfs_root,
+			    wm8960, &wm8960_clk_table_fops);
+	debugfs_create_file("clk_error", 0444, component->debugfs_root,
+			    wm8960, &wm8960_clk_error_fops);
+	debugfs_create_u32("writes_saved", 0444, component->debugfs_root,
+			   &wm8960->writes_saved);
+	debugfs_create_u32("resync_us", 0444, component->debugfs_root,
+			   &wm8960->resync_us);
+#endif
+
 	return 0;
 }
 
+#ifdef CONFIG_PM
+static int wm8960_suspend(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	/*
+	 * The supplies may go away, so the chip is reset before the cache
+	 * is synced back; until then keep further writes in the cache.
+	 */
+	regcache_cache_only(wm8960->regmap, true);
+	regcache_mark_dirty(wm8960->regmap);
+	wm8960->pll_locked = false;
+
+	return 0;
+}
+
+static int wm8960_resume(struct snd_soc_component *component)
+{
+	struct wm8960_priv *wm8960 = snd_soc_component_get_drvdata(component);
+
+	/* Registers are synced by wm8960_resync() once a stream starts */
+	wm8960->resync = true;
+	wm8960->resumed = ktime_get();
+
+	return 0;
+}
+#else
+#define wm8960_suspend NULL
+#define wm8960_resume NULL
+#endif
+
 static const struct snd_soc_component_driver soc_component_dev_wm8960 = {
 	.probe			= wm8960_probe,
+	.suspend		= wm8960_suspend,
+	.resume			= wm8960_resume,
 	.set_bias_level		= wm8960_set_bias_level,
 	.suspend_bias_off	= 1,
 	.idle_bias_on		= 1,
@@ -1395,11 +3425,21 @@ static const struct regmap_config wm8960_regmap = {
 
 	.reg_defaults = wm8960_reg_defaults,
 	.num_reg_defaults = ARRAY_SIZE(wm8960_reg_defaults),
-	.cache_type = REGCACHE_RBTREE,
+	.cache_type = REGCACHE_FLAT,
 
 	.volatile_reg = wm8960_volatile,
+	.readable_reg = wm8960_readable,
+	.writeable_reg = wm8960_writeable,
 };
 
+static void wm8960_cancel_work(void *data)
+{
+	struct wm8960_priv *wm8960 = data;
+
+	cancel_delayed_work_sync(&wm8960->discharge_work);
+	cancel_delayed_work_sync(&wm8960->keep_warm_work);
+}
+
 static void wm8960_set_pdata_from_of(struct i2c_client *i2c,
 				struct wm8960_data *pdata)
 {
@@ -1412,10 +3452,60 @@ static void wm8960_set_pdata_from_of(struct i2c_client *i2c,
 		pdata->shared_lrclk = true;
 }
 
+static void wm8960_set_priv_from_of(struct i2c_client *i2c,
+				    struct wm8960_priv *wm8960)
+{
+	const struct device_node *np = i2c->dev.of_node;
+	u32 val;
+	int ret;
+
+	if (of_property_read_bool(np, "wlf,vmid-fast-start"))
+		wm8960->vmid_fast = true;
+
+	if (of_property_read_bool(np, "wlf,prefer-mclk-rates"))
+		wm8960->prefer_mclk = true;
+
+	if (of_property_read_bool(np, "wlf,continuous-rates"))
+		wm8960->continuous_rates = true;
+
+	ret = of_property_count_u32_elems(np, "wlf,mclk-rates");
+	if (ret > 0) {
+		wm8960->num_mclk_rates = min(ret, WM8960_MCLK_RATES_MAX);
+		of_property_read_u32_array(np, "wlf,mclk-rates",
+					   wm8960->mclk_rates,
+					   wm8960->num_mclk_rates);
+	}
+
+	if (of_property_read_bool(np, "wlf,asymmetric-rates")) {
+		if (wm8960->pdata.shared_lrclk)
+			dev_warn(&i2c->dev,
+				 "Asymmetric rates need separate LRCLKs, ignored\n");
+		else
+			wm8960->asym_rates = true;
+	}
+
+	if (!of_property_read_u32(np, "wlf,clock-domain", &val)) {
+		if (val)
+			wm8960->clk_domain_id = val;
+		else
+			dev_warn(&i2c->dev, "Ignoring clock domain 0\n");
+	}
+
+	if (!of_property_read_u32(np, "wlf,vmid-fast-start-ms", &val)) {
+		if (val >= 1 && val <= WM8960_VMID_FAST_MAX_MS)
+			wm8960->vmid_fast_ms = val;
+		else
+			dev_warn(&i2c->dev,
+				 "Ignoring invalid VMID fast start time %u\n",
+				 val);
+	}
+}
+
 static int wm8960_i2c_probe(struct i2c_client *i2c,
 			    const struct i2c_device_id *id)
 {
 	struct wm8960_data *pdata = dev_get_platdata(&i2c->dev);
+	struct snd_soc_dai_driver *dai;
 	struct wm8960_priv *wm8960;
 	int ret;
 
@@ -1430,7 +3520,15 @@ static int wm8960_i2c_probe(struct i2c_client *i2c,
 			return -EPROBE_DEFER;
 	}
 
-	wm8960->regmap = devm_regmap_init_i2c(i2c, &wm8960_regmap);
+	wm8960->i2c = i2c;
+
+	wm8960->i2c_burst = i2c_check_functionality(i2c->adapter,
+						    I2C_FUNC_I2C);
+	mutex_init(&wm8960->burst_lock);
+	mutex_init(&wm8960->pll_lock);
+
+	wm8960->regmap = devm_regmap_init(&i2c->dev, &wm8960_i2c_bus, wm8960,
+					  &wm8960_regmap);
 	if (IS_ERR(wm8960->regmap))
 		return PTR_ERR(wm8960->regmap);
 
@@ -1439,21 +3537,41 @@ static int wm8960_i2c_probe(struct i2c_client *i2c,
 	else if (i2c->dev.of_node)
 		wm8960_set_pdata_from_of(i2c, &wm8960->pdata);
 
+	wm8960->vmid_fast_ms = WM8960_VMID_FAST_MS;
+	INIT_DELAYED_WORK(&wm8960->discharge_work, wm8960_discharge_work);
+	INIT_DELAYED_WORK(&wm8960->keep_warm_work, wm8960_keep_warm_work);
+	wm8960->keep_warm_ms = min_t(unsigned int, keep_warm_ms,
+				     WM8960_KEEP_WARM_MAX_MS);
+	init_completion(&wm8960->discharged);
+	complete_all(&wm8960->discharged);
+	if (i2c->dev.of_node)
+		wm8960_set_priv_from_of(i2c, wm8960);
+
+	ret = wm8960_join_clk_domain(wm8960);
+	if (ret)
+		return ret;
+	if (wm8960->clk_domain) {
+		ret = devm_add_action_or_reset(&i2c->dev,
+					       wm8960_leave_clk_domain, wm8960);
+		if (ret)
+			return ret;
+	}
+
 	ret = wm8960_reset(wm8960->regmap);
 	if (ret != 0) {
 		dev_err(&i2c->dev, "Failed to issue reset\n");
 		return ret;
 	}
 
-	if (wm8960->pdata.shared_lrclk) {
-		ret = regmap_update_bits(wm8960->regmap, WM8960_ADDCTL2,
-					 0x4, 0x4);
-		if (ret != 0) {
-			dev_err(&i2c->dev, "Failed to enable LRCM: %d\n",
-				ret);
-			return ret;
-		}
-	}
+	/*
+	 * The chip is now in its reset state, which the cache defaults
+	 * describe, so stage the initial setup in the cache and send
+	 * everything that differs from the defaults in one burst.
+	 */
+	regcache_cache_only(wm8960->regmap, true);
+
+	if (wm8960->pdata.shared_lrclk)
+		regmap_update_bits(wm8960->regmap, WM8960_ADDCTL2, 0x4, 0x4);
 
 	/* Latch the update bits */
 	regmap_update_bits(wm8960->regmap, WM8960_LINVOL, 0x100, 0x100);
@@ -1467,10 +3585,42 @@ static int wm8960_i2c_probe(struct i2c_client *i2c,
 	regmap_update_bits(wm8960->regmap, WM8960_LOUT2, 0x100, 0x100);
 	regmap_update_bits(wm8960->regmap, WM8960_ROUT2, 0x100, 0x100);
 
+	regcache_cache_only(wm8960->regmap, false);
+	ret = wm8960_sync(wm8960);
+	if (ret != 0) {
+		dev_err(&i2c->dev, "Failed to set up registers: %d\n", ret);
+		return ret;
+	}
+
 	i2c_set_clientdata(i2c, wm8960);
 
+	/* Registered first so that it runs after the component is gone */
+	ret = devm_add_action_or_reset(&i2c->dev, wm8960_cancel_work, wm8960);
+	if (ret)
+		return ret;
+
+	dai = &wm8960_dai;
+	if (wm8960->continuous_rates || wm8960->asym_rates) {
+		dai = devm_kmemdup(&i2c->dev, &wm8960_dai, sizeof(wm8960_dai),
+				   GFP_KERNEL);
+		if (!dai)
+			return -ENOMEM;
+	}
+
+	if (wm8960->continuous_rates) {
+		dai->playback.rates = SNDRV_PCM_RATE_CONTINUOUS;
+		dai->capture.rates = SNDRV_PCM_RATE_CONTINUOUS;
+	}
+
+	if (wm8960->asym_rates)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,15,0)
+		dai->symmetric_rates = 0;
+#else
+		dai->symmetric_rate = 0;
+#endif
+
 	ret = devm_snd_soc_register_component(&i2c->dev,
-			&soc_component_dev_wm8960, &wm8960_dai, 1);
+			&soc_component_dev_wm8960, dai, 1);
 
 	return ret;
 }
@@ -1502,6 +3652,7 @@ static struct i2c_driver wm8960_i2c_driver = {
 	.driver = {
 		.name = "wm8960",
 		.of_match_table = wm8960_of_match,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe =    wm8960_i2c_probe,
 	.remove =   wm8960_i2c_remove,